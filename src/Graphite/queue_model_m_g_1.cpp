@@ -29,7 +29,9 @@ QueueModelMG1::computeQueueDelay(UInt64 pkt_time, UInt64 service_time, int reque
       volatile double arrival_rate = ((double) _num_arrivals) / _newest_arrival_time;
 
       //LOG_PRINT("variance_serve_time(%g), service_rate(%g), arrival_rate(%g)\n", variance_service_time, service_rate, arrival_rate);
-      if (arrival_rate >= service_rate)
+      // Clamp to a utilization of 0.999, rates just below the service rate would
+      // otherwise divide by almost zero
+      if (arrival_rate >= 0.999 * service_rate)
          arrival_rate = 0.999 * service_rate;
       
       waiting_time_queue = (UInt64) ceil(0.5 * service_rate * arrival_rate * ( (1 / square(service_rate)) + variance_service_time) / (service_rate - arrival_rate));
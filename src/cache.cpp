@@ -1,5 +1,5 @@
 //===========================================================================
-// cache.cpp simulates a single cache with LRU replacement policy. 
+// cache.cpp simulates a single cache with a configurable replacement policy. 
 //===========================================================================
 /*
 Copyright (c) 2015 Princeton University
@@ -38,21 +38,147 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <assert.h>
 #include <sys/time.h>
 #include <time.h>
+#include <sched.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 #include "cache.h"
 #include "common.h"
 
 using namespace std;
 
+typedef char line_size_check[(sizeof(Line) == sizeof(uint64_t)) ? 1 : -1];
 
+// Layout of the packed set lock word: the up and down locks in the lowest
+// bits and a sequence counter above them, bumped upon every release
+#define LOCK_UP_BIT     0x1U
+#define LOCK_DOWN_BIT   0x2U
+#define LOCK_BITS       (LOCK_UP_BIT | LOCK_DOWN_BIT)
+#define LOCK_SEQ_INC    0x4U
+#define LOCK_SPIN_COUNT 64
 
+int Cache::lookup_kernel = -1;
 
-void Cache::init(XmlCache* xml_cache, CacheType cache_type_in, int bus_latency, int page_size_in, int level_in, int cache_id_in)
+
+// Scalar lookup kernels, used for the tails of the vectorized ones and on
+// hosts without AVX2
+static int matchWayScalar(uint64_t* tags, Line* lines, int num_ways, uint64_t tag, uint32_t id)
+{
+    for (int i = 0; i < num_ways; i++) {
+        if( (tags[i] == tag)
+        &&  (lines[i].id == id)
+        &&   lines[i].state) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int freeWayScalar(Line* lines, int num_ways)
+{
+    for (int i = 0; i < num_ways; i++) {
+        if (lines[i].state == I) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Tags of a set are compared in 64-bit lanes and only the ways whose tag
+// matches go on to check the program id and state, which keeps the scan on
+// the packed tag array.
+static inline int matchCandidates(Line* lines, int base, int mask, uint32_t id)
+{
+    while (mask) {
+        int i = base + __builtin_ctz(mask);
+        if ((lines[i].id == id) && lines[i].state) {
+            return i;
+        }
+        mask &= mask - 1;
+    }
+    return -1;
+}
+
+__attribute__((target("avx2")))
+static int matchWayAvx2(uint64_t* tags, Line* lines, int num_ways, uint64_t tag, uint32_t id)
+{
+    __m256i tag_vec = _mm256_set1_epi64x(tag);
+    int i, way, mask;
+    for (i = 0; i + 8 <= num_ways; i += 8) {
+        __m256i hit_lo = _mm256_cmpeq_epi64(_mm256_loadu_si256((__m256i*)(tags + i)), tag_vec);
+        __m256i hit_hi = _mm256_cmpeq_epi64(_mm256_loadu_si256((__m256i*)(tags + i + 4)), tag_vec);
+        mask = _mm256_movemask_pd(_mm256_castsi256_pd(hit_lo))
+             | (_mm256_movemask_pd(_mm256_castsi256_pd(hit_hi)) << 4);
+        if (mask && (way = matchCandidates(lines, i, mask, id)) >= 0) {
+            return way;
+        }
+    }
+    if (i + 4 <= num_ways) {
+        mask = _mm256_movemask_pd(_mm256_castsi256_pd(
+               _mm256_cmpeq_epi64(_mm256_loadu_si256((__m256i*)(tags + i)), tag_vec)));
+        if (mask && (way = matchCandidates(lines, i, mask, id)) >= 0) {
+            return way;
+        }
+        i += 4;
+    }
+    way = matchWayScalar(tags + i, lines + i, num_ways - i, tag, id);
+    return (way < 0) ? -1 : i + way;
+}
+
+__attribute__((target("avx2")))
+static int freeWayAvx2(Line* lines, int num_ways)
+{
+    __m256i state_mask = _mm256_set1_epi64x(LINE_STATE_MASK);
+    __m256i zero = _mm256_setzero_si256();
+    int i, way;
+    for (i = 0; i + 4 <= num_ways; i += 4) {
+        __m256i line_cur = _mm256_loadu_si256((__m256i*)(lines + i));
+        __m256i invalid = _mm256_cmpeq_epi64(_mm256_and_si256(line_cur, state_mask), zero);
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(invalid));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    way = freeWayScalar(lines + i, num_ways - i);
+    return (way < 0) ? -1 : i + way;
+}
+
+#endif
+
+// Select the lookup kernels of the caches initialized from now on. The
+// vectorized free way search relies on the state being the lowest bits of a
+// Line, so AVX2 is only used if the compiler laid the bit fields out as
+// expected. Returns false if the requested kernels cannot run on this host,
+// in which case the scalar loops are used.
+bool Cache::selectLookup(int kernel)
+{
+    Line probe;
+    uint64_t image;
+    bool avx2 = false;
+
+    memset(&probe, 0, sizeof(probe));
+    probe.state = 7;
+    memcpy(&image, &probe, sizeof(image));
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    avx2 = (image == LINE_STATE_MASK) && __builtin_cpu_supports("avx2");
+#endif
+    if (kernel != LOOKUP_SCALAR && !avx2) {
+        lookup_kernel = LOOKUP_SCALAR;
+        return kernel == LOOKUP_AUTO;
+    }
+    lookup_kernel = kernel;
+    return true;
+}
+
+
+
+void Cache::init(XmlCache* xml_cache, CacheType cache_type_in, int bus_latency, int page_size_in, int level_in, int cache_id_in, int sharer_words_in)
 {
-    ins_count = 0;;
-    miss_count = 0;
-    evict_count = 0;
-    wb_count = 0;
+    stats.init(NUM_CACHE_STATS);
     size = xml_cache->size;
     num_ways = xml_cache->num_ways;
     block_size = xml_cache->block_size;
@@ -74,41 +200,120 @@ void Cache::init(XmlCache* xml_cache, CacheType cache_type_in, int bus_latency,
     index_bits  = (int) (log2(num_sets));
     index_mask  = (uint64_t)(num_sets - 1);
 
-    if (cache_type == DATA_CACHE || cache_type == DIRECTORY_CACHE) {
-        line = new Line* [num_sets];
-        lock_up = new pthread_mutex_t [num_sets];
-        lock_down = new pthread_mutex_t [num_sets];
-        for (uint64_t i = 0; i < num_sets; i++ ) {
-            pthread_mutex_init(&lock_up[i], NULL);
-            pthread_mutex_init(&lock_down[i], NULL);
-            line[i] = new Line [num_ways];
-            for (uint64_t j = 0; j < num_ways; j++ ) {
-                line[i][j].state = I;
-                line[i][j].id = 0;
-                line[i][j].set_num = i;
-                line[i][j].way_num = j;
-                line[i][j].tag = 0;
-                line[i][j].ppage_num = 0;
-                line[i][j].timestamp = 0;
+    //Set counts that are not a power of two are indexed by a division, with
+    //the quotient as the tag so that addresses can be composed back
+    index_type = xml_cache->index_type;
+    index_sets = num_sets;
+    index_div = (num_sets & (num_sets - 1)) != 0;
+    group_mask = 0;
+    if ((index_type == INDEX_XOR || index_type == INDEX_SKEW) && (index_div || index_bits == 0)) {
+        cerr << "Warning: XOR and skewed indexing need a power-of-two set count above one, "
+             << "falling back to the mask index!\n";
+        index_type = INDEX_MASK;
+    }
+    if (index_type == INDEX_PRIME) {
+        index_div = true;
+        while (index_sets > 2) {
+            uint64_t i;
+            for (i = 2; i * i <= index_sets && index_sets % i; i++);
+            if (i * i > index_sets) {
+                break;
             }
+            index_sets--;
         }
     }
-    else if (cache_type == TLB_CACHE) {
-        line = new Line* [num_sets];
+    else if (index_type == INDEX_SKEW) {
+        group_mask = (1 << (index_bits < SKEW_GROUP_BITS ? index_bits : SKEW_GROUP_BITS)) - 1;
+    }
+    else if (index_type != INDEX_MASK && index_type != INDEX_XOR) {
+        cerr << "Error: Undefined index type!\n";
+        assert(false);
+    }
+
+    //tools/lookup_bench measured the vectorized kernels slower than the
+    //scalar loops at 8 ways and no faster at 16 ways, SSE4.2 ones even
+    //on AVX2 hosts, so only AVX2 is used and only for wider sets
+    if (lookup_kernel < 0) {
+        selectLookup(LOOKUP_AUTO);
+    }
+    match_way = matchWayScalar;
+    free_way = freeWayScalar;
+#if defined(__x86_64__) || defined(__i386__)
+    if (lookup_kernel == LOOKUP_AVX2
+    || (lookup_kernel == LOOKUP_AUTO && num_ways > LOOKUP_VECTOR_WAYS)) {
+        match_way = matchWayAvx2;
+        free_way = freeWayAvx2;
+    }
+#endif
+
+    if (num_ways > MAX_WAYS) {
+        cerr << "Error: At most " << MAX_WAYS << " ways are supported!\n";
+    }
+    assert(num_ways <= MAX_WAYS);
+
+    repl_policy = ReplPolicy::create(xml_cache->repl_policy, num_ways, num_sets);
+
+    //Each set is stored as one contiguous record: packed tags first, then
+    //the per-way line metadata and the replacement state, and finally the
+    //physical page numbers for TLB caches or the sharers for directory caches
+    sharer_words = (cache_type == DIRECTORY_CACHE) ? sharer_words_in : 0;
+    line_offset = num_ways * sizeof(uint64_t);
+    repl_offset = line_offset + num_ways * sizeof(Line);
+    ppage_offset = (repl_offset + repl_policy->getSetBytes() + 7) & ~(uint64_t)7;
+    sharer_offset = ppage_offset;
+    set_bytes = ppage_offset;
+    if (cache_type == TLB_CACHE) {
+        set_bytes += num_ways * sizeof(uint64_t);
+    }
+    set_bytes += num_ways * sharer_words * sizeof(uint64_t);
+
+    //Sparse caches only allocate chunks of sets upon their first fill, so
+    //their memory follows the working set rather than the capacity
+    sparse = (cache_type != TLB_CACHE) && xml_cache->sparse;
+    arena_cur = NULL;
+    arena_left = 0;
+    set_mapped = false;
+    if (sparse) {
+        uint64_t num_chunks = (num_sets + SPARSE_CHUNK_SETS - 1) >> SPARSE_CHUNK_BITS;
+        set_store = NULL;
+        chunk_store = new char* [num_chunks];
+        memset(chunk_store, 0, num_chunks * sizeof(char*));
+        pthread_mutex_init(&arena_lock, NULL);
+        alloc_sets = 0;
+    }
+    else {
+        chunk_store = NULL;
+        set_store = new char [num_sets * set_bytes];
+        memset(set_store, 0, num_sets * set_bytes);
         for (uint64_t i = 0; i < num_sets; i++ ) {
-            line[i] = new Line [num_ways];
-            for (uint64_t j = 0; j < num_ways; j++ ) {
-                line[i][j].state = I;
-                line[i][j].id = 0;
-                line[i][j].set_num = i;
-                line[i][j].way_num = j;
-                line[i][j].tag = 0;
-                line[i][j].ppage_num = 0;
-                line[i][j].timestamp = 0;
+            initFrame(set_store + i * set_bytes, i);
+        }
+        alloc_sets = num_sets;
+    }
+
+    lock_type = xml_cache->lock_type;
+    lock_up = NULL;
+    lock_down = NULL;
+    set_lock = NULL;
+    if (cache_type == DATA_CACHE || cache_type == DIRECTORY_CACHE) {
+        if (lock_type == SEQ_LOCK) {
+            set_lock = new uint32_t [num_sets];
+            memset(set_lock, 0, num_sets * sizeof(uint32_t));
+        }
+        else if (lock_type == MUTEX_LOCK) {
+            lock_up = new pthread_mutex_t [num_sets];
+            lock_down = new pthread_mutex_t [num_sets];
+            for (uint64_t i = 0; i < num_sets; i++ ) {
+                pthread_mutex_init(&lock_up[i], NULL);
+                pthread_mutex_init(&lock_down[i], NULL);
             }
         }
+        else {
+            cerr << "Error: Undefined lock type!\n";
+            assert(false);
+        }
     }
-    else {
+    else if (cache_type != TLB_CACHE) {
         cerr << "Error: Undefined cache type!\n";
     }
     if (xml_cache->share > 1) {
@@ -118,14 +323,139 @@ void Cache::init(XmlCache* xml_cache, CacheType cache_type_in, int bus_latency,
     else {
         bus = NULL;
     }
+    if (cache_type == DATA_CACHE && xml_cache->num_mshrs > 0) {
+        mshr = new Mshr;
+        mshr->init(xml_cache->num_mshrs, block_size);
+    }
+    else {
+        mshr = NULL;
+    }
+    prefetcher = (cache_type == DATA_CACHE) ? Prefetcher::create(xml_cache) : NULL;
+
+    //Per-set lookups, fills and evictions to spot hot sets and conflicts
+    if (cache_type != TLB_CACHE && xml_cache->set_stats) {
+        set_access_count = new uint64_t [num_sets];
+        set_miss_count = new uint64_t [num_sets];
+        set_evict_count = new uint64_t [num_sets];
+        memset(set_access_count, 0, num_sets * sizeof(uint64_t));
+        memset(set_miss_count, 0, num_sets * sizeof(uint64_t));
+        memset(set_evict_count, 0, num_sets * sizeof(uint64_t));
+    }
+    else {
+        set_access_count = NULL;
+        set_miss_count = NULL;
+        set_evict_count = NULL;
+    }
 }
 
 
 
+// This function returns the record of a set, NULL is returned for a set of
+// a sparse cache that has never been filled.
+char* Cache::findFrame(uint64_t index)
+{
+    if (set_store != NULL) {
+        return set_store + index * set_bytes;
+    }
+    char* chunk = __atomic_load_n(&chunk_store[index >> SPARSE_CHUNK_BITS], __ATOMIC_ACQUIRE);
+    if (chunk == NULL) {
+        return NULL;
+    }
+    return chunk + (index & (SPARSE_CHUNK_SETS - 1)) * set_bytes;
+}
+
+// This function returns the record of a set and allocates the chunk holding
+// it from the arena first if needed.
+char* Cache::allocFrame(uint64_t index)
+{
+    char* frame = findFrame(index);
+    if (frame != NULL) {
+        return frame;
+    }
+    uint64_t chunk_id = index >> SPARSE_CHUNK_BITS;
+    pthread_mutex_lock(&arena_lock);
+    if (chunk_store[chunk_id] == NULL) {
+        uint64_t first_set = chunk_id << SPARSE_CHUNK_BITS;
+        uint64_t chunk_sets = num_sets - first_set;
+        if (chunk_sets > SPARSE_CHUNK_SETS) {
+            chunk_sets = SPARSE_CHUNK_SETS;
+        }
+        uint64_t chunk_bytes = chunk_sets * set_bytes;
+        if (arena_left < chunk_bytes) {
+            arena_left = (chunk_bytes > ARENA_BLOCK_BYTES) ? chunk_bytes : ARENA_BLOCK_BYTES;
+            arena_cur = new char [arena_left];
+            arena_blocks.push_back(arena_cur);
+        }
+        char* chunk = arena_cur;
+        arena_cur += chunk_bytes;
+        arena_left -= chunk_bytes;
+        memset(chunk, 0, chunk_bytes);
+        for (uint64_t i = 0; i < chunk_sets; i++) {
+            initFrame(chunk + i * set_bytes, first_set + i);
+        }
+        alloc_sets += chunk_sets;
+        //Publish the chunk only once it is initialized for lock-free readers
+        __atomic_store_n(&chunk_store[chunk_id], chunk, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&arena_lock);
+    return findFrame(index);
+}
+
+void Cache::initFrame(char* frame, uint64_t index)
+{
+    Line* set_cur = (Line*)(frame + line_offset);
+    for (uint64_t j = 0; j < num_ways; j++ ) {
+        set_cur[j].state = I;
+        set_cur[j].way = j;
+        set_cur[j].set = index;
+    }
+    repl_policy->initSet((uint8_t*)(frame + repl_offset), index);
+}
+
 Line* Cache::findSet(int index)
 {
     assert(index >= 0 && index < (int)num_sets);
-    return line[index];
+    char* frame = findFrame(index);
+    if (frame == NULL) {
+        return NULL;
+    }
+    return (Line*)(frame + line_offset);
+}
+
+uint64_t* Cache::findTags(uint64_t index)
+{
+    return (uint64_t*)findFrame(index);
+}
+
+uint8_t* Cache::findRepl(uint64_t index)
+{
+    return (uint8_t*)(findFrame(index) + repl_offset);
+}
+
+uint64_t* Cache::findPpages(uint64_t index)
+{
+    return (uint64_t*)(findFrame(index) + ppage_offset);
+}
+
+// Sharers are only kept for directory caches, in the format chosen by the
+// protocol type
+uint64_t* Cache::getSharers(Line* line)
+{
+    assert(sharer_words > 0);
+    return (uint64_t*)(findFrame(line->set) + sharer_offset) + line->way * sharer_words;
+}
+
+// Physical page numbers are only kept for TLB caches
+uint64_t Cache::getPpageNum(Line* line)
+{
+    assert(cache_type == TLB_CACHE);
+    return findPpages(line->set)[line->way];
+}
+
+void Cache::setPpageNum(Line* line, uint64_t ppage_num)
+{
+    assert(cache_type == TLB_CACHE);
+    findPpages(line->set)[line->way] = ppage_num;
 }
 
 int Cache::reverseBits(int num, int size)
@@ -139,16 +469,45 @@ int Cache::reverseBits(int num, int size)
    return reverse_num;
 }
 
+// This function folds a tag into index_bits by XORing all its slices.
+uint64_t Cache::foldTag(uint64_t tag)
+{
+    uint64_t fold = 0;
+    while (tag) {
+        fold ^= tag & index_mask;
+        tag >>= index_bits;
+    }
+    return fold;
+}
+
+// This function returns the offset of a way of a skewed cache from the XOR
+// index within its group of sets, way 0 stays at the XOR index.
+uint64_t Cache::skewIndex(uint64_t tag, int way)
+{
+    if (way == 0) {
+        return 0;
+    }
+    return (((tag + way) * 0x9E3779B97F4A7C15ULL) >> 32) & group_mask;
+}
+
 // This function parses each memory reference address into three separate parts
 // according to the cache configuration: offset, index and tag.
 
 void Cache::addrParse(uint64_t addr_in, Addr* addr_out)
 {
-
-    addr_out->offset =  addr_in & offset_mask;
-    addr_out->tag    =  addr_in >> (offset_bits + index_bits);
-    //hash
-    addr_out->index  = (addr_in >> offset_bits) % num_sets;
+    uint64_t line_addr = addr_in >> offset_bits;
+    addr_out->offset = addr_in & offset_mask;
+    if (index_div) {
+        addr_out->tag = line_addr / index_sets;
+        addr_out->index = line_addr - addr_out->tag * index_sets;
+    }
+    else {
+        addr_out->tag = line_addr >> index_bits;
+        addr_out->index = line_addr & index_mask;
+        if (index_type != INDEX_MASK) {
+            addr_out->index ^= foldTag(addr_out->tag);
+        }
+    }
 }
 
 // This function composes three separate parts: offset, index and tag into
@@ -156,26 +515,44 @@ void Cache::addrParse(uint64_t addr_in, Addr* addr_out)
 
 void Cache::addrCompose(Addr* addr_in, uint64_t* addr_out)
 {
-    //recover
-    *addr_out = addr_in->offset 
-              | (addr_in->index << offset_bits) 
-              | (addr_in->tag << (offset_bits+index_bits));
+    uint64_t line_addr;
+    if (index_div) {
+        line_addr = addr_in->tag * index_sets + addr_in->index;
+    }
+    else if (index_type != INDEX_MASK) {
+        line_addr = (addr_in->tag << index_bits) | (addr_in->index ^ foldTag(addr_in->tag));
+    }
+    else {
+        line_addr = (addr_in->tag << index_bits) | addr_in->index;
+    }
+    *addr_out = addr_in->offset | (line_addr << offset_bits);
 }
 
-// This function implements the LRU replacement policy in a cache set.
+// This function returns the address of the line held in a way of a set.
+uint64_t Cache::lineAddr(uint64_t index, int way)
+{
+    Addr addr;
+    uint64_t addr_dmem;
+    addr.tag = findTags(index)[way];
+    addr.index = index ^ skewIndex(addr.tag, way);
+    addr.offset = 0;
+    addrCompose(&addr, &addr_dmem);
+    return addr_dmem;
+}
 
-int Cache::lru(uint64_t index)
+// All sets a line may be placed in by a skewed cache share the lock of the
+// first set of their group.
+uint64_t Cache::lockIndex(Addr* addr)
 {
-    uint64_t i; 
-    int min_time = 0;
-    Line* set_cur = findSet(index);
-    assert(set_cur != NULL);
-    for (i = 1; i < num_ways; i++) {
-        if (set_cur[i].timestamp < set_cur[min_time].timestamp) {
-            min_time = i;
-        }
-    }
-    return min_time;
+    assert(addr->index < num_sets);
+    return addr->index & ~group_mask;
+}
+
+// This function updates the replacement state of a set upon a hit on a line,
+// fills are accounted for by replaceLine.
+void Cache::touchLine(Line* line)
+{
+    repl_policy->touch(findRepl(line->set), line->set, line->way);
 }
 
 
@@ -183,15 +560,41 @@ int Cache::lru(uint64_t index)
 // NULL is returned upon a cache miss.
 Line* Cache::accessLine(InsMem* ins_mem)
 {
-    uint64_t i;
-    Line* set_cur;
     Addr addr_temp;
     addrParse(ins_mem->addr_dmem, &addr_temp);
-    set_cur = findSet(addr_temp.index);
-    assert(set_cur != NULL);
-    for (i = 0; i < num_ways; i++) {
-        if( (set_cur[i].id == ins_mem->prog_id)
-        &&  (set_cur[i].tag == addr_temp.tag)
+    return accessLine(ins_mem, &addr_temp);
+}
+
+// Same as above with the address of the instruction already parsed for this
+// cache, which saves parsing it again for each step of an access.
+Line* Cache::accessLine(InsMem* ins_mem, Addr* addr)
+{
+    int way;
+    char* frame;
+    if (index_type == INDEX_SKEW) {
+        return matchSkewed(addr, ins_mem->prog_id);
+    }
+    frame = findFrame(addr->index);
+    if (frame == NULL) {
+        return NULL;
+    }
+    way = match_way((uint64_t*)frame, (Line*)(frame + line_offset), num_ways, 
+                    addr->tag, ins_mem->prog_id);
+    if (way < 0) {
+        return NULL;
+    }
+    return (Line*)(frame + line_offset) + way;
+}
+
+// Each way of a skewed cache is looked up in its own set.
+Line* Cache::matchSkewed(Addr* addr, uint32_t id)
+{
+    for (uint64_t i = 0; i < num_ways; i++) {
+        uint64_t index = addr->index ^ skewIndex(addr->tag, i);
+        Line* set_cur = findSet(index);
+        if( (set_cur != NULL)
+        &&  (findTags(index)[i] == addr->tag)
+        &&  (set_cur[i].id == id)
         &&   set_cur[i].state) {
             return &set_cur[i];
         }
@@ -199,37 +602,74 @@ Line* Cache::accessLine(InsMem* ins_mem)
     return NULL;
 }
 
+// The victim of a skewed cache is the first free way among the sets of the
+// line, or otherwise the way its set ranks highest for replacement.
+int Cache::victimSkewed(Addr* addr)
+{
+    int way_rp = 0, rank_max = -1;
+    for (uint64_t i = 0; i < num_ways; i++) {
+        uint64_t index = addr->index ^ skewIndex(addr->tag, i);
+        allocFrame(index);
+        Line* set_cur = findSet(index);
+        if (set_cur[i].state == I) {
+            return i;
+        }
+        int rank = repl_policy->rank(findRepl(index), index, i);
+        if (rank > rank_max) {
+            rank_max = rank;
+            way_rp = i;
+        }
+    }
+    return way_rp;
+}
+
 // This function replaces the cache line the instruction want to access and returns
 // a pointer to this line, the replaced content is copied to ins_mem_old.
 Line* Cache::replaceLine(InsMem* ins_mem_old, InsMem* ins_mem)
 {
-    Addr addr_old;
     Addr addr_temp;
+    addrParse(ins_mem->addr_dmem, &addr_temp);
+    return replaceLine(ins_mem_old, ins_mem, &addr_temp);
+}
+
+Line* Cache::replaceLine(InsMem* ins_mem_old, InsMem* ins_mem, Addr* addr)
+{
     int way_rp;
-    uint64_t i, addr_dmem_old;
+    uint64_t index;
     Line* set_cur;
-    addrParse(ins_mem->addr_dmem, &addr_temp);
-    set_cur = findSet(addr_temp.index);
-    
-    for (i = 0; i < num_ways; i++) {
-        if (set_cur[i].state == I) {
-           set_cur[i].id = ins_mem->prog_id; 
-           set_cur[i].tag = addr_temp.tag;
-           return &set_cur[i]; 
+    uint64_t* tag_cur;
+    assert(ins_mem->prog_id >= 0 && ins_mem->prog_id <= MAX_PROG_ID);
+
+    if (index_type == INDEX_SKEW) {
+        way_rp = victimSkewed(addr);
+        index = addr->index ^ skewIndex(addr->tag, way_rp);
+        set_cur = findSet(index);
+    }
+    else {
+        index = addr->index;
+        allocFrame(index);
+        set_cur = findSet(index);
+        way_rp = free_way(set_cur, num_ways);
+        if (way_rp < 0) {
+            way_rp = repl_policy->victim(findRepl(index), index);
         }
     }
-    way_rp = lru(addr_temp.index);
-    addr_old.index = addr_temp.index;
-    addr_old.tag = set_cur[way_rp].tag;
-    addr_old.offset = 0;
-    addrCompose(&addr_old, &addr_dmem_old);
-    
-    ins_mem_old->prog_id = set_cur[way_rp].id;
-    ins_mem_old->addr_dmem = addr_dmem_old;
+    tag_cur = findTags(index);
 
+    if (set_cur[way_rp].state) {
+        ins_mem_old->prog_id = set_cur[way_rp].id;
+        ins_mem_old->addr_dmem = lineAddr(index, way_rp);
+    }
+    if (set_miss_count != NULL && !stat_warmup) {
+        set_miss_count[index]++;
+        if (set_cur[way_rp].state) {
+            set_evict_count[index]++;
+        }
+    }
     set_cur[way_rp].id = ins_mem->prog_id; 
-    set_cur[way_rp].tag = addr_temp.tag;
-
+    set_cur[way_rp].prefetched = 0;
+    tag_cur[way_rp] = addr->tag;
+    repl_policy->insert(findRepl(index), index, way_rp);
 
     return &set_cur[way_rp]; 
 }
@@ -245,15 +685,8 @@ Line* Cache::directAccess(int set, int way, InsMem* ins_mem)
         return NULL;
     }
     else if (set_cur[way].state) {
-        Addr addr;
-        uint64_t addr_dmem;
-        addr.index = set;
-        addr.tag = set_cur[way].tag;
-        addr.offset = 0;
-        addrCompose(&addr, &addr_dmem);
-        
         ins_mem->prog_id = set_cur[way].id;
-        ins_mem->addr_dmem = addr_dmem;
+        ins_mem->addr_dmem = lineAddr(set, way);
         return &set_cur[way];
     }
     else {
@@ -264,11 +697,18 @@ Line* Cache::directAccess(int set, int way, InsMem* ins_mem)
 void Cache::flushAll()
 {
     for (uint64_t i = 0; i < num_sets; i++) {
-        for (uint64_t j = 0; j < num_sets; j++) {
-            line[i][j].state = I;
-            line[i][j].id = 0;
-            line[i][j].tag = 0;
-            line[i][j].sharer_set.clear();
+        Line* set_cur = findSet(i);
+        uint64_t* tag_cur = findTags(i);
+        if (set_cur == NULL) {
+            continue;
+        }
+        for (uint64_t j = 0; j < num_ways; j++) {
+            set_cur[j].state = I;
+            set_cur[j].id = 0;
+            tag_cur[j] = 0;
+            if (sharer_words > 0) {
+                memset(getSharers(&set_cur[j]), 0, sharer_words * sizeof(uint64_t));
+            }
         }
     }
 }
@@ -278,25 +718,22 @@ Line* Cache::flushLine(int set, int way, InsMem* ins_mem_old)
     assert(set >= 0 && set < (int)num_sets);
     assert(way >= 0 && way < (int)num_ways);
     Line* set_cur;
+    uint64_t* tag_cur;
     set_cur = findSet(set);
     if (set_cur == NULL) {
         return NULL;
     }
     else if(set_cur[way].state) {
-        set_cur[way].state = I;
-        set_cur[way].id = 0;
-        set_cur[way].tag = 0;
-        set_cur[way].sharer_set.clear();
-        Addr addr_old;
-        uint64_t addr_dmem_old;
-        addr_old.index = set;
-        addr_old.tag = set_cur[way].tag;
-        addr_old.offset = 0;
-        addrCompose(&addr_old, &addr_dmem_old);
-        
+        tag_cur = findTags(set);
         ins_mem_old->prog_id = set_cur[way].id;
-        ins_mem_old->addr_dmem = addr_dmem_old;
+        ins_mem_old->addr_dmem = lineAddr(set, way);
 
+        set_cur[way].state = I;
+        set_cur[way].id = 0;
+        tag_cur[way] = 0;
+        if (sharer_words > 0) {
+            memset(getSharers(&set_cur[way]), 0, sharer_words * sizeof(uint64_t));
+        }
         return &set_cur[way];
     }
     else {
@@ -311,8 +748,10 @@ Line* Cache::flushAddr(InsMem* ins_mem)
     if (cur_line != NULL) {
         cur_line->state = I;
         cur_line->id = 0;
-        cur_line->tag = 0;
-        cur_line->sharer_set.clear();
+        findTags(cur_line->set)[cur_line->way] = 0;
+        if (sharer_words > 0) {
+            memset(getSharers(cur_line), 0, sharer_words * sizeof(uint64_t));
+        }
         return cur_line;
     }
     else {
@@ -320,34 +759,129 @@ Line* Cache::flushAddr(InsMem* ins_mem)
     }
 }
 
+// Both bit locks of a set live in the same word, so a lock is taken by
+// setting its bit with a CAS and released by clearing it and bumping the
+// sequence counter in one atomic add. Waiters yield the processor after a
+// short spin since the lock may be held across a whole coherence transaction.
+void Cache::spinLock(uint32_t* lock_word, uint32_t lock_bit)
+{
+    int spin = 0;
+    while (true) {
+        uint32_t word = __atomic_load_n(lock_word, __ATOMIC_RELAXED);
+        if (!(word & lock_bit)
+        &&  __sync_bool_compare_and_swap(lock_word, word, word | lock_bit)) {
+            return;
+        }
+        if (++spin < LOCK_SPIN_COUNT) {
+#if defined(__x86_64__) || defined(__i386__)
+            _mm_pause();
+#endif
+        }
+        else {
+            spin = 0;
+            sched_yield();
+        }
+    }
+}
+
+void Cache::spinUnlock(uint32_t* lock_word, uint32_t lock_bit)
+{
+    __sync_fetch_and_add(lock_word, LOCK_SEQ_INC - lock_bit);
+}
+
 void Cache::lockUp(InsMem* ins_mem)
 {
     Addr addr_temp;
     addrParse(ins_mem->addr_dmem, &addr_temp);
-    assert(addr_temp.index >= 0 && addr_temp.index < num_sets);
-    pthread_mutex_lock(&lock_up[addr_temp.index]);
+    lockUp(&addr_temp);
+}
+
+void Cache::lockUp(Addr* addr)
+{
+    uint64_t index = lockIndex(addr);
+    if (lock_type == SEQ_LOCK) {
+        spinLock(&set_lock[index], LOCK_UP_BIT);
+    }
+    else {
+        pthread_mutex_lock(&lock_up[index]);
+    }
 }
 
 void Cache::unlockUp(InsMem* ins_mem)
 {
     Addr addr_temp;
     addrParse(ins_mem->addr_dmem, &addr_temp);
-    assert(addr_temp.index >= 0 && addr_temp.index < num_sets);
-    pthread_mutex_unlock(&lock_up[addr_temp.index]);
+    unlockUp(&addr_temp);
+}
+
+void Cache::unlockUp(Addr* addr)
+{
+    uint64_t index = lockIndex(addr);
+    if (lock_type == SEQ_LOCK) {
+        spinUnlock(&set_lock[index], LOCK_UP_BIT);
+    }
+    else {
+        pthread_mutex_unlock(&lock_up[index]);
+    }
 }
 
 void Cache::lockDown(InsMem* ins_mem)
 {
     Addr addr_temp;
     addrParse(ins_mem->addr_dmem, &addr_temp);
-    pthread_mutex_lock(&lock_down[addr_temp.index]);
+    lockDown(&addr_temp);
+}
+
+void Cache::lockDown(Addr* addr)
+{
+    uint64_t index = lockIndex(addr);
+    if (lock_type == SEQ_LOCK) {
+        spinLock(&set_lock[index], LOCK_DOWN_BIT);
+    }
+    else {
+        pthread_mutex_lock(&lock_down[index]);
+    }
 }
 
 void Cache::unlockDown(InsMem* ins_mem)
 {
     Addr addr_temp;
     addrParse(ins_mem->addr_dmem, &addr_temp);
-    pthread_mutex_unlock(&lock_down[addr_temp.index]);
+    unlockDown(&addr_temp);
+}
+
+void Cache::unlockDown(Addr* addr)
+{
+    uint64_t index = lockIndex(addr);
+    if (lock_type == SEQ_LOCK) {
+        spinUnlock(&set_lock[index], LOCK_DOWN_BIT);
+    }
+    else {
+        pthread_mutex_unlock(&lock_down[index]);
+    }
+}
+
+int Cache::getLockType()
+{
+    return lock_type;
+}
+
+// Optimistic readers snapshot the lock word of a set before a lookup and
+// validate it afterwards, the lookup is only valid if no lock was held in
+// between. Only SEQ_LOCK caches support optimistic reads.
+uint32_t Cache::readBegin(Addr* addr)
+{
+    assert(lock_type == SEQ_LOCK);
+    uint64_t index = lockIndex(addr);
+    return __atomic_load_n(&set_lock[index], __ATOMIC_ACQUIRE);
+}
+
+bool Cache::readValidate(Addr* addr, uint32_t seq)
+{
+    uint64_t index = lockIndex(addr);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return !(seq & LOCK_BITS)
+        && (__atomic_load_n(&set_lock[index], __ATOMIC_RELAXED) == seq);
 }
 
 int  Cache::getAccessTime()
@@ -370,6 +904,11 @@ uint64_t Cache::getNumWays()
     return num_ways;
 }
 
+uint64_t Cache::getAllocSets()
+{
+    return alloc_sets;
+}
+
 uint64_t Cache::getBlockSize()
 {
     return block_size;
@@ -387,86 +926,294 @@ int Cache::getIndexBits()
 
 void Cache::incInsCount()
 {
-    ins_count++;
+    stats.inc(CACHE_INS);
+}
+
+// Same as above for a demand access to the set of the parsed address, which
+// is also counted per set with the set_stats option. Read hits count it from
+// lock-free paths, so the set counter is bumped atomically.
+void Cache::incInsCount(Addr* addr)
+{
+    stats.inc(CACHE_INS);
+    if (set_access_count != NULL && !stat_warmup) {
+        __atomic_fetch_add(&set_access_count[addr->index], 1, __ATOMIC_RELAXED);
+    }
+}
+
+void Cache::incInsCount(InsMem* ins_mem)
+{
+    Addr addr;
+    if (set_access_count == NULL) {
+        stats.inc(CACHE_INS);
+        return;
+    }
+    addrParse(ins_mem->addr_dmem, &addr);
+    incInsCount(&addr);
 }
 
 void Cache::incMissCount()
 {
-    miss_count++;
+    stats.inc(CACHE_MISS);
 }
 
 void Cache::incWbCount()
 {
-    wb_count++;
+    stats.inc(CACHE_WB);
 }
 
 void Cache::incEvictCount()
 {
-    evict_count++;
+    stats.inc(CACHE_EVICT);
 }
 
 uint64_t Cache::getInsCount()
 {
-    return ins_count;
+    return stats.get(CACHE_INS);
 }
 
 uint64_t Cache::getMissCount()
 {
-    return miss_count;
+    return stats.get(CACHE_MISS);
 }
 
 uint64_t Cache::getWbCount()
 {
-    return wb_count;
+    return stats.get(CACHE_WB);
 }
 
 uint64_t Cache::getEvictCount()
 {
-    return evict_count;
+    return stats.get(CACHE_EVICT);
 }
 
 
 
 void Cache::report(ofstream* result)
 {
+    uint64_t ins_count = stats.get(CACHE_INS);
+    uint64_t miss_count = stats.get(CACHE_MISS);
     *result << "=================================================================\n";
     *result << "Simulation results for "<< size << " Bytes " << num_ways
             << "-way set associative cache model:\n";
     *result << "The total # of memory instructions: " << ins_count << endl;
     *result << "The # of cache-missed instructions: " << miss_count << endl;
-    *result << "The # of evicted instructions: " << evict_count << endl;
-    *result << "The # of writeback instructions: " << wb_count << endl;
+    *result << "The # of evicted instructions: " << stats.get(CACHE_EVICT) << endl;
+    *result << "The # of writeback instructions: " << stats.get(CACHE_WB) << endl;
     *result << "The cache miss rate: " << 100 * (double)miss_count/ (double)ins_count << "%" << endl;
+    if (sparse) {
+        *result << "The # of allocated sets: " << alloc_sets << " out of " << num_sets << endl;
+    }
+    if (mshr != NULL) {
+        mshr->report(result);
+    }
+    if (prefetcher != NULL) {
+        prefetcher->report(result);
+    }
+    if (set_access_count != NULL) {
+        uint64_t hot_set = 0, total_access = 0;
+        for (uint64_t i = 0; i < num_sets; i++) {
+            total_access += set_access_count[i];
+            if (set_access_count[i] > set_access_count[hot_set]) {
+                hot_set = i;
+            }
+        }
+        *result << "The average # of accesses per set: " << (double)total_access / num_sets << endl;
+        *result << "The # of accesses to the hottest set " << hot_set << ": " << set_access_count[hot_set] << endl;
+        *result << "The # of fills and evictions of the hottest set: " << set_miss_count[hot_set]
+                << " " << set_evict_count[hot_set] << endl;
+    }
     *result << "=================================================================\n\n";
 }
 
+bool Cache::hasSetStats()
+{
+    return set_access_count != NULL;
+}
+
+// This function writes the per-set counters as CSV rows of the form
+// name,cache_id,set,accesses,misses,evictions. Sets that were never accessed
+// are skipped to keep the dump compact.
+void Cache::dumpSetStats(ofstream* result, const char* name)
+{
+    if (set_access_count == NULL) {
+        return;
+    }
+    for (uint64_t i = 0; i < num_sets; i++) {
+        if (set_access_count[i] || set_miss_count[i]) {
+            *result << name << "," << cache_id << "," << i << "," << set_access_count[i] << ","
+                    << set_miss_count[i] << "," << set_evict_count[i] << "\n";
+        }
+    }
+}
+
+// This function saves the set records as one block of the checkpoint, a
+// sparse cache only saves its allocated chunks preceded by their ids
+void Cache::save(Checkpoint* ckpt)
+{
+    uint64_t num_chunks, chunk_sets, first_set;
+    vector<uint64_t> chunk_ids;
+    bool set_stats = (set_access_count != NULL);
+
+    ckpt->write(&num_sets, sizeof(num_sets));
+    ckpt->write(&set_bytes, sizeof(set_bytes));
+    ckpt->write(&sparse, sizeof(sparse));
+    ckpt->write(&set_stats, sizeof(set_stats));
+    stats.save(ckpt);
+    if (set_access_count != NULL) {
+        ckpt->write(set_access_count, num_sets * sizeof(uint64_t));
+        ckpt->write(set_miss_count, num_sets * sizeof(uint64_t));
+        ckpt->write(set_evict_count, num_sets * sizeof(uint64_t));
+    }
+    if (sparse) {
+        num_chunks = (num_sets + SPARSE_CHUNK_SETS - 1) >> SPARSE_CHUNK_BITS;
+        for (uint64_t i = 0; i < num_chunks; i++) {
+            if (chunk_store[i] != NULL) {
+                chunk_ids.push_back(i);
+            }
+        }
+        num_chunks = chunk_ids.size();
+        ckpt->write(&num_chunks, sizeof(num_chunks));
+        if (num_chunks > 0) {
+            ckpt->write(&chunk_ids[0], num_chunks * sizeof(uint64_t));
+        }
+        ckpt->beginBlock();
+        for (uint64_t i = 0; i < num_chunks; i++) {
+            first_set = chunk_ids[i] << SPARSE_CHUNK_BITS;
+            chunk_sets = num_sets - first_set;
+            if (chunk_sets > SPARSE_CHUNK_SETS) {
+                chunk_sets = SPARSE_CHUNK_SETS;
+            }
+            ckpt->write(chunk_store[chunk_ids[i]], chunk_sets * set_bytes);
+        }
+    }
+    else {
+        ckpt->writeBlock(set_store, num_sets * set_bytes);
+    }
+    repl_policy->save(ckpt);
+    if (mshr != NULL) {
+        mshr->save(ckpt);
+    }
+    if (prefetcher != NULL) {
+        prefetcher->save(ckpt);
+    }
+}
+
+// This function restores a cache initialized with the same configuration as
+// the saved one. The set records are used in place from the mapped checkpoint.
+bool Cache::restore(Checkpoint* ckpt)
+{
+    uint64_t num_sets_saved, set_bytes_saved, num_chunks, chunk_sets, first_set, offset;
+    int sparse_saved;
+    bool set_stats_saved;
+    char* block;
+
+    ckpt->read(&num_sets_saved, sizeof(num_sets_saved));
+    ckpt->read(&set_bytes_saved, sizeof(set_bytes_saved));
+    ckpt->read(&sparse_saved, sizeof(sparse_saved));
+    ckpt->read(&set_stats_saved, sizeof(set_stats_saved));
+    if (!ckpt->good() || num_sets_saved != num_sets || set_bytes_saved != set_bytes
+     || sparse_saved != sparse || set_stats_saved != (set_access_count != NULL)) {
+        cerr << "Error: Checkpoint does not match the cache configuration!\n";
+        return false;
+    }
+    stats.restore(ckpt);
+    if (set_access_count != NULL) {
+        ckpt->read(set_access_count, num_sets * sizeof(uint64_t));
+        ckpt->read(set_miss_count, num_sets * sizeof(uint64_t));
+        ckpt->read(set_evict_count, num_sets * sizeof(uint64_t));
+    }
+    if (sparse) {
+        ckpt->read(&num_chunks, sizeof(num_chunks));
+        if (!ckpt->good() || num_chunks > ((num_sets + SPARSE_CHUNK_SETS - 1) >> SPARSE_CHUNK_BITS)) {
+            return false;
+        }
+        vector<uint64_t> chunk_ids(num_chunks);
+        uint64_t total_sets = 0;
+        if (num_chunks > 0) {
+            ckpt->read(&chunk_ids[0], num_chunks * sizeof(uint64_t));
+        }
+        for (uint64_t i = 0; i < num_chunks; i++) {
+            first_set = chunk_ids[i] << SPARSE_CHUNK_BITS;
+            if (first_set >= num_sets) {
+                return false;
+            }
+            chunk_sets = num_sets - first_set;
+            total_sets += (chunk_sets > SPARSE_CHUNK_SETS) ? SPARSE_CHUNK_SETS : chunk_sets;
+        }
+        block = ckpt->readBlock(total_sets * set_bytes);
+        if (block == NULL) {
+            return false;
+        }
+        offset = 0;
+        for (uint64_t i = 0; i < num_chunks; i++) {
+            first_set = chunk_ids[i] << SPARSE_CHUNK_BITS;
+            chunk_sets = num_sets - first_set;
+            if (chunk_sets > SPARSE_CHUNK_SETS) {
+                chunk_sets = SPARSE_CHUNK_SETS;
+            }
+            chunk_store[chunk_ids[i]] = block + offset;
+            offset += chunk_sets * set_bytes;
+        }
+        alloc_sets = total_sets;
+    }
+    else {
+        block = ckpt->readBlock(num_sets * set_bytes);
+        if (block == NULL) {
+            return false;
+        }
+        if (!set_mapped) {
+            delete [] set_store;
+        }
+        set_store = block;
+        set_mapped = true;
+    }
+    repl_policy->restore(ckpt);
+    if (mshr != NULL) {
+        mshr->restore(ckpt);
+    }
+    if (prefetcher != NULL) {
+        prefetcher->restore(ckpt);
+    }
+    return ckpt->good();
+}
+
 Cache::~Cache()
 {
     if (cache_type == DATA_CACHE || cache_type == DIRECTORY_CACHE) {
-        for (uint64_t i = 0; i < num_sets; i++ ) {
-            pthread_mutex_destroy(&lock_up[i]);
-            pthread_mutex_destroy(&lock_down[i]);
-            delete [] line[i];
+        if (lock_type == MUTEX_LOCK) {
+            for (uint64_t i = 0; i < num_sets; i++ ) {
+                pthread_mutex_destroy(&lock_up[i]);
+                pthread_mutex_destroy(&lock_down[i]);
+            }
         }
         delete [] lock_up;
         delete [] lock_down;
-        delete [] line;
+        delete [] set_lock;
     }
-    else if (cache_type == TLB_CACHE) {
-        for (uint64_t i = 0; i < num_sets; i++ ) {
-            delete [] line[i];
-        }
-        delete [] line;
-    }
-    else {
+    else if (cache_type != TLB_CACHE) {
         cerr << "Error: Undefined cache type!\n";
     }
+    if (!set_mapped) {
+        delete [] set_store;
+    }
+    if (sparse) {
+        for (uint64_t i = 0; i < arena_blocks.size(); i++) {
+            delete [] arena_blocks[i];
+        }
+        delete [] chunk_store;
+        pthread_mutex_destroy(&arena_lock);
+    }
+    delete repl_policy;
     if (bus != NULL) {
         delete bus;
     }
+    if (mshr != NULL) {
+        delete mshr;
+    }
+    if (prefetcher != NULL) {
+        delete prefetcher;
+    }
+    delete [] set_access_count;
+    delete [] set_miss_count;
+    delete [] set_evict_count;
 }
-
-
-
-
-
@@ -38,10 +38,34 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <pthread.h> 
 #include <set>
 #include <map>
+#include <vector>
 #include "xml_parser.h"
 #include "bus.h"
+#include "mshr.h"
+#include "repl_policy.h"
+#include "prefetcher.h"
+#include "checkpoint.h"
+#include "stats.h"
 #include "common.h"
 
+#define MAX_WAYS     256    // bounded by the 8-bit LRU age of each way
+#define MAX_PROG_ID  65535  // bounded by the 16-bit program id of each line
+
+#define SPARSE_CHUNK_BITS  6                        // sparse caches allocate 64 sets at a time
+#define SPARSE_CHUNK_SETS  (1 << SPARSE_CHUNK_BITS)
+#define ARENA_BLOCK_BYTES  (1 << 20)                // chunks are carved from 1MB arena blocks
+#define SKEW_GROUP_BITS    4                        // skewed ways stay within groups of 16 sets
+
+//Counters of the stats group of a cache, in checkpoint order
+typedef enum CacheStat
+{
+    CACHE_INS = 0,
+    CACHE_MISS = 1,
+    CACHE_EVICT = 2,
+    CACHE_WB = 3,
+    NUM_CACHE_STATS = 4
+} CacheStat;
+
 typedef struct Addr
 {
     uint64_t    index;
@@ -58,7 +82,9 @@ typedef enum State
     E     =   2, //exclusive
     M     =   3, //modified
     V     =   4, //valid 
-    B     =   5  //broadcast
+    B     =   5, //broadcast
+    O     =   6, //owned, dirty and shared (MOESI)
+    F     =   7  //forward, clean and shared (MESIF)
 } State;
 
 typedef enum CacheType
@@ -68,24 +94,53 @@ typedef enum CacheType
     TLB_CACHE          = 2,
 } CacheType;
 
+typedef enum IndexType
+{
+    INDEX_MASK         = 0, //low bits of the line address, modulo for non power-of-two set counts
+    INDEX_XOR          = 1, //low bits XORed with the folded tag
+    INDEX_PRIME        = 2, //modulo the largest prime not above the set count
+    INDEX_SKEW         = 3  //XOR index skewed by a different hash in each way
+} IndexType;
+
+typedef enum LockType
+{
+    MUTEX_LOCK         = 0, //a pair of pthread mutexes per set
+    SEQ_LOCK           = 1  //one packed word per set with two bit locks and a sequence counter
+} LockType;
+
 
 
 
 
 typedef set<int> IntSet;
 
+// Per-way metadata handed out to the coherence protocol. Tags live in a
+// separate packed array of the same set so that lookups only touch them.
 typedef struct Line
 {
-    char        state;
-    int         id;
-    int         set_num;
-    int         way_num;
-    uint64_t    tag;
-    int64_t     timestamp;
-    uint64_t    ppage_num;  //only for tlb cache
-    IntSet      sharer_set; //only for directory cache
+    uint32_t    state : 3;
+    uint32_t    prefetched : 1; //filled by a prefetch and not used yet
+    uint32_t    way   : 12;
+    uint32_t    id    : 16;
+    uint32_t    set;
 } Line;
 
+// Mask of the state bits in the 64-bit image of a Line
+#define LINE_STATE_MASK  0x0000000000000007ULL
+
+// Lookup kernels scanning all ways of a set in one pass, selected at runtime
+typedef enum LookupKernel
+{
+    LOOKUP_AUTO        = 0, //AVX2 for caches with more than LOOKUP_VECTOR_WAYS ways if the host supports it
+    LOOKUP_SCALAR      = 1,
+    LOOKUP_AVX2        = 2
+} LookupKernel;
+
+#define LOOKUP_VECTOR_WAYS 16  //the scalar loops are as fast up to this many ways
+
+typedef int (*MatchWayFunc)(uint64_t* tags, Line* lines, int num_ways, uint64_t tag, uint32_t id);
+typedef int (*FreeWayFunc)(Line* lines, int num_ways);
+
 
 typedef map<int, Line*> LineMap;
 
@@ -96,6 +151,9 @@ typedef struct InsMem
     int         thread_id;
     int         rec_thread_id;
     uint64_t    addr_dmem; 
+    uint64_t    addr_ins;
+    bool        prefetch; // issued by a prefetcher rather than by the core
+    bool        warmup;   // only updates cache state, no timing is modeled
 } InsMem;
 
 
@@ -106,15 +164,25 @@ class Cache
         Cache*      parent;
         Cache**     child;
         Bus*        bus;
-        void init(XmlCache* xml_cache, CacheType cache_type_in, int bus_latency, int page_size_in, int level_in, int cache_id_in);
+        Prefetcher* prefetcher;
+        Mshr*       mshr;
+        void init(XmlCache* xml_cache, CacheType cache_type_in, int bus_latency, int page_size_in, int level_in, int cache_id_in, int sharer_words_in);
         Line* accessLine(InsMem* ins_mem);
+        Line* accessLine(InsMem* ins_mem, Addr* addr);
         Line* directAccess(int set, int way, InsMem* ins_mem);
         Line* replaceLine(InsMem* ins_mem_old, InsMem* ins_mem);
+        Line* replaceLine(InsMem* ins_mem_old, InsMem* ins_mem, Addr* addr);
         void flushAll();
         Line* flushLine(int set, int way, InsMem* ins_mem_old);
         Line* flushAddr(InsMem* ins_mem);
         Line* findSet(int index);
+        void touchLine(Line* line);
+        uint64_t* getSharers(Line* line);
+        uint64_t getPpageNum(Line* line);
+        void setPpageNum(Line* line, uint64_t ppage_num);
         void incInsCount();
+        void incInsCount(Addr* addr);
+        void incInsCount(InsMem* ins_mem);
         void incMissCount();
         void incEvictCount();
         void incWbCount();
@@ -122,10 +190,18 @@ class Cache
         void unlockUp(InsMem* ins_mem);
         void lockDown(InsMem* ins_mem);
         void unlockDown(InsMem* ins_mem);
+        void lockUp(Addr* addr);
+        void unlockUp(Addr* addr);
+        void lockDown(Addr* addr);
+        void unlockDown(Addr* addr);
+        int getLockType();
+        uint32_t readBegin(Addr* addr);
+        bool readValidate(Addr* addr, uint32_t seq);
         int  getAccessTime();
         uint64_t getSize();
         uint64_t getNumSets();
         uint64_t getNumWays();
+        uint64_t getAllocSets();
         uint64_t getBlockSize();
         int getOffsetBits();
         int getIndexBits();
@@ -135,21 +211,57 @@ class Cache
         uint64_t getWbCount();
         void addrParse(uint64_t addr_in, Addr* addr_out);
         void addrCompose(Addr* addr_in, uint64_t* addr_out);
-        int lru(uint64_t index);
         void report(ofstream* result);
+        bool hasSetStats();
+        void dumpSetStats(ofstream* result, const char* name);
+        void save(Checkpoint* ckpt);
+        bool restore(Checkpoint* ckpt);
         ~Cache();
+        static bool selectLookup(int kernel);
     private:
+        static int  lookup_kernel;
+        MatchWayFunc match_way;
+        FreeWayFunc  free_way;
         int reverseBits(int num, int size);
-        Line              **line;
+        void spinLock(uint32_t* lock_word, uint32_t lock_bit);
+        void spinUnlock(uint32_t* lock_word, uint32_t lock_bit);
+        uint64_t foldTag(uint64_t tag);
+        uint64_t skewIndex(uint64_t tag, int way);
+        uint64_t lockIndex(Addr* addr);
+        uint64_t lineAddr(uint64_t index, int way);
+        Line* matchSkewed(Addr* addr, uint32_t id);
+        int victimSkewed(Addr* addr);
+        char* findFrame(uint64_t index);
+        char* allocFrame(uint64_t index);
+        void initFrame(char* frame, uint64_t index);
+        uint64_t* findTags(uint64_t index);
+        uint8_t* findRepl(uint64_t index);
+        uint64_t* findPpages(uint64_t index);
+        char              *set_store;
+        bool              set_mapped; //set_store points into a restored checkpoint
+        char              **chunk_store;
+        vector<char*>     arena_blocks;
+        char              *arena_cur;
+        uint64_t          arena_left;
+        uint64_t          alloc_sets;
+        pthread_mutex_t   arena_lock;
+        int               sparse;
+        uint64_t          set_bytes;
+        uint64_t          line_offset;
+        uint64_t          repl_offset;
+        uint64_t          ppage_offset;
+        uint64_t          sharer_offset;
+        int               sharer_words;
+        ReplPolicy        *repl_policy;
         pthread_mutex_t   *lock_up;
         pthread_mutex_t   *lock_down;
+        uint32_t          *set_lock;
+        int               lock_type;
         CacheType         cache_type;
         int               access_time;
-        uint64_t          ins_count;
-        uint64_t          miss_count;
-        uint64_t          evict_count;
-        uint64_t          wb_count;
-        uint64_t*         set_access_count;
+        Stats             stats;
+        uint64_t*         set_access_count; //per-set counters, NULL unless set_stats is on
+        uint64_t*         set_miss_count;
         uint64_t*         set_evict_count;
         uint64_t          size;
         uint64_t          num_ways;
@@ -162,6 +274,10 @@ class Cache
         int               cache_id;
         uint64_t          offset_mask;
         uint64_t          index_mask;
+        int               index_type;
+        bool              index_div;
+        uint64_t          index_sets;
+        uint64_t          group_mask;
 
 };
 
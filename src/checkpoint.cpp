@@ -0,0 +1,193 @@
+//===========================================================================
+// checkpoint.cpp writes and maps checkpoint files of the uncore state. 
+//===========================================================================
+/*
+Copyright (c) 2015 Princeton University
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Princeton University nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY PRINCETON UNIVERSITY "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL PRINCETON UNIVERSITY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <cstring>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "checkpoint.h"
+
+using namespace std;
+
+Checkpoint::Checkpoint()
+{
+    file = NULL;
+    image = NULL;
+    image_size = 0;
+    pos = 0;
+    failed = false;
+}
+
+// This function opens a checkpoint file for writing and writes its header
+bool Checkpoint::create(const char* path)
+{
+    uint64_t header[2] = {CKPT_MAGIC, CKPT_VERSION};
+
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        cerr << "Error: Cannot create checkpoint file " << path << "!\n";
+        failed = true;
+        return false;
+    }
+    pos = 0;
+    failed = false;
+    write(header, sizeof(header));
+    return !failed;
+}
+
+// This function maps a checkpoint file privately and checks its header
+bool Checkpoint::open(const char* path)
+{
+    int fd;
+    struct stat st;
+    uint64_t header[2];
+
+    fd = ::open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        cerr << "Error: Cannot open checkpoint file " << path << "!\n";
+        if (fd >= 0) {
+            close(fd);
+        }
+        failed = true;
+        return false;
+    }
+    image_size = st.st_size;
+    image = (char*)mmap(NULL, image_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        cerr << "Error: Cannot map checkpoint file " << path << "!\n";
+        image = NULL;
+        failed = true;
+        return false;
+    }
+    pos = 0;
+    failed = false;
+    read(header, sizeof(header));
+    if (failed || header[0] != CKPT_MAGIC || header[1] != CKPT_VERSION) {
+        cerr << "Error: " << path << " is not a checkpoint of this version!\n";
+        failed = true;
+    }
+    return !failed;
+}
+
+// This function closes a checkpoint file after writing. A mapped checkpoint
+// stays mapped since restored modules may still use its blocks.
+bool Checkpoint::finish()
+{
+    if (file != NULL) {
+        if (fclose(file) != 0) {
+            failed = true;
+        }
+        file = NULL;
+    }
+    return !failed;
+}
+
+bool Checkpoint::good()
+{
+    return !failed;
+}
+
+void Checkpoint::write(const void* data, uint64_t len)
+{
+    if (failed || file == NULL) {
+        failed = true;
+        return;
+    }
+    if (len > 0 && fwrite(data, 1, len, file) != len) {
+        cerr << "Error: Cannot write checkpoint file!\n";
+        failed = true;
+        return;
+    }
+    pos += len;
+}
+
+// This function pads the file up to the next page boundary
+void Checkpoint::align()
+{
+    static const char zeros[CKPT_ALIGN] = {0};
+    uint64_t pad = (CKPT_ALIGN - pos % CKPT_ALIGN) % CKPT_ALIGN;
+    if (file != NULL) {
+        write(zeros, pad);
+    }
+    else {
+        pos += pad;
+    }
+}
+
+// This function starts a block that is written in several parts
+void Checkpoint::beginBlock()
+{
+    align();
+}
+
+void Checkpoint::writeBlock(const void* data, uint64_t len)
+{
+    align();
+    write(data, len);
+}
+
+void Checkpoint::read(void* data, uint64_t len)
+{
+    if (failed || image == NULL || pos + len > image_size) {
+        memset(data, 0, len);
+        failed = true;
+        return;
+    }
+    memcpy(data, image + pos, len);
+    pos += len;
+}
+
+// This function returns a block in place, NULL is returned if the file is
+// too short
+char* Checkpoint::readBlock(uint64_t len)
+{
+    char* block;
+    align();
+    if (failed || image == NULL || pos + len > image_size) {
+        failed = true;
+        return NULL;
+    }
+    block = image + pos;
+    pos += len;
+    return block;
+}
+
+Checkpoint::~Checkpoint()
+{
+    finish();
+    if (image != NULL) {
+        munmap(image, image_size);
+    }
+}
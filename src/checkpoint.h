@@ -0,0 +1,70 @@
+//===========================================================================
+// checkpoint.h 
+//===========================================================================
+/*
+Copyright (c) 2015 Princeton University
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Princeton University nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY PRINCETON UNIVERSITY "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL PRINCETON UNIVERSITY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#define CKPT_MAGIC    0x504b43454d495250ULL  // "PRIMECKP" in little endian
+#define CKPT_VERSION  9
+#define CKPT_ALIGN    4096                   // blocks start at page boundaries
+
+// A checkpoint file is a header followed by the state of each module in a
+// fixed order. Small values are copied in and out with write and read, while
+// large arrays are written as page-aligned blocks. Upon restore the whole file
+// is mapped privately, so a block can be used in place with copy-on-write
+// instead of being copied, and the mapping lives as long as the checkpoint.
+class Checkpoint
+{
+    public:
+        Checkpoint();
+        ~Checkpoint();
+        bool create(const char* path);
+        bool open(const char* path);
+        bool finish();
+        bool good();
+        void write(const void* data, uint64_t len);
+        void beginBlock();
+        void writeBlock(const void* data, uint64_t len);
+        void read(void* data, uint64_t len);
+        char* readBlock(uint64_t len);
+    private:
+        void align();
+        FILE*       file;
+        char*       image;
+        uint64_t    image_size;
+        uint64_t    pos;
+        bool        failed;
+};
+
+
+#endif // CHECKPOINT_H
@@ -34,6 +34,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define PADSIZE 56  // 64 byte line size: 64-8
 #define THREAD_MAX  1024 // Maximum number of threads in one process
+#define LEVEL_MAX   8    // Maximum number of cache levels
 
 enum MessageTypes
 {
@@ -51,6 +52,8 @@ typedef struct MsgMem
     bool        mem_type; //1 means write, 0 means read
     int         mem_size; 
     uint64_t    addr_dmem; 
+    uint64_t    addr_ins; //instruction pointer, used by PC-indexed prefetchers
+    bool        warmup;   //issued during the functional warmup of the thread
     union
     {
         int64_t     timer;
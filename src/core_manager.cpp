@@ -60,6 +60,8 @@ void CoreManager::init(XmlSim* xml_sim, int num_procs_in, int rank_in)
     thread_sync_interval = xml_sim->thread_sync_interval;
     proc_sync_interval = xml_sim->proc_sync_interval;
     syscall_cost = xml_sim->syscall_cost;
+    warmup_ins = xml_sim->warmup_ins;
+    sample_interval = xml_sim->sample_interval;
     freq = xml_sim->sys.freq;
     num_recv_threads = xml_sim->num_recv_threads;
     num_procs = num_procs_in;
@@ -77,12 +79,21 @@ void CoreManager::init(XmlSim* xml_sim, int num_procs_in, int rank_in)
     memset(sys_wait, 0, sizeof(sys_wait));
 
     PIN_InitLock(&thread_lock);
+    PIN_InitLock(&sample_lock);
     PIN_MutexInit(&mutex);
     PIN_SemaphoreInit(&sem);
     PIN_SemaphoreClear(&sem);
 
 }
 
+// This function opens the CSV file the IPC of each thread is appended to
+// every sample_interval cycles of the thread
+void CoreManager::initSampling(const char* path)
+{
+    sample_file.open(path);
+    sample_file << "cycle,thread,instructions,ipc\n";
+}
+
 void CoreManager::startSim(MPI_Comm * new_comm)
 {
     msg_mem[0][0].message_type = PROCESS_STARTING;
@@ -97,6 +108,45 @@ void CoreManager::startSim(MPI_Comm * new_comm)
 void CoreManager::insCount(uint32_t ins_count_in, THREADID threadid)
 {
     ins_count[threadid]._count += ins_count_in;
+    if (thread_state[threadid] == WARMUP && ins_count[threadid]._count >= warmup_ins) {
+        endWarmup(threadid);
+    }
+}
+
+
+// This function switches a thread from functional warmup to timing simulation.
+// The requests still buffered are sent as warmup requests first, then the
+// thread joins the barriers at the average cycle of the other threads and its
+// instruction counts start over.
+void CoreManager::endWarmup(THREADID threadid)
+{
+    if (mpi_pos[threadid] > 1) {
+        msg_mem[threadid][0].mem_type = 0;
+        msg_mem[threadid][0].addr_dmem = mpi_pos[threadid];
+        msg_mem[threadid][0].mem_size = threadid;
+        msg_mem[threadid][0].message_type = MEM_REQUESTS;
+        MPI_Send(msg_mem[threadid], mpi_pos[threadid] * sizeof(MsgMem), MPI_CHAR, 0, core[threadid], MPI_COMM_WORLD);
+        MPI_Recv(&delay[threadid], 1, MPI_INT, 0, threadid, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+        if (delay[threadid] == -1) {
+            cerr<<"An error occurs in cache system\n";
+            MPI_Abort(MPI_COMM_WORLD, -1);
+            PIN_ExitApplication(-1);
+        }
+        mpi_pos[threadid] = 1;
+    }
+
+    PIN_GetLock(&thread_lock, threadid+1);
+    if (num_threads > 0) {
+        cycle[threadid]._count = getAvgCycle(threadid);
+    }
+    ins_count[threadid]._count = 0;
+    ins_nonmem[threadid]._count = 0;
+    startSample(threadid);
+    thread_state[threadid] = ACTIVE;
+    num_threads++;
+    cout << "[PriME] Thread " << threadid << " finishes warmup at cycle "<< (uint64_t)cycle[threadid]._count << endl;
+    PIN_ReleaseLock(&thread_lock);
 }
 
 
@@ -228,25 +278,61 @@ double CoreManager::getAvgCycle(THREADID threadid)
 // Handle non-memory instructions
 void CoreManager::execNonMem(uint32_t ins_count_in, THREADID threadid)
 {
+    if (thread_state[threadid] == WARMUP) {
+        ins_nonmem[threadid]._count += ins_count_in;
+        return;
+    }
     cycle[threadid]._count += cpi_nonmem * ins_count_in;
     ins_nonmem[threadid]._count += ins_count_in;
     barrier(threadid); 
+    sample(threadid);
+}
+
+
+// This function starts the sampling interval of a thread at its current cycle
+void CoreManager::startSample(THREADID threadid)
+{
+    sample_cycle[threadid]._count = cycle[threadid]._count;
+    sample_ins[threadid]._count = ins_count[threadid]._count;
+}
+
+
+// This function appends the IPC of a thread once it has run for another
+// sampling interval since its last sample
+void CoreManager::sample(THREADID threadid)
+{
+    double ins, cycles;
+    if (sample_interval == 0 || cycle[threadid]._count < sample_cycle[threadid]._count + sample_interval) {
+        return;
+    }
+    ins = ins_count[threadid]._count - sample_ins[threadid]._count;
+    cycles = cycle[threadid]._count - sample_cycle[threadid]._count;
+    PIN_GetLock(&sample_lock, threadid+1);
+    sample_file << (uint64_t)cycle[threadid]._count << "," << threadid << "," << (uint64_t)ins << "," << ins / cycles << "\n";
+    PIN_ReleaseLock(&sample_lock);
+    startSample(threadid);
 }
 
 
 
 
 // Handle a memory instruction
-void CoreManager::execMem(void * addr, THREADID threadid, uint32_t size, BOOL mem_type)
+void CoreManager::execMem(void * addr, void * ip, THREADID threadid, uint32_t size, BOOL mem_type)
 {
 
     delay[threadid] = 0;
     msg_mem[threadid][mpi_pos[threadid]].mem_type = mem_type;
     msg_mem[threadid][mpi_pos[threadid]].addr_dmem = (uint64_t) addr;
+    msg_mem[threadid][mpi_pos[threadid]].addr_ins = (uint64_t) ip;
     msg_mem[threadid][mpi_pos[threadid]].mem_size = size;
     msg_mem[threadid][mpi_pos[threadid]].timer = (int64_t)(cycle[threadid]._count);
+    msg_mem[threadid][mpi_pos[threadid]].warmup = (thread_state[threadid] == WARMUP);
     
-    cycle[threadid]._count += 1;
+    //Warmup requests only update the uncore state, so the thread does not
+    //advance its clock or take part in barriers
+    if (thread_state[threadid] != WARMUP) {
+        cycle[threadid]._count += 1;
+    }
     mpi_pos[threadid]++;
     if (mpi_pos[threadid] >= (max_msg_size + 1)) {
         msg_mem[threadid][0].mem_type = 0;
@@ -262,10 +348,15 @@ void CoreManager::execMem(void * addr, THREADID threadid, uint32_t size, BOOL me
             MPI_Abort(MPI_COMM_WORLD, -1);
             PIN_ExitApplication(-1);
         }
-        cycle[threadid]._count += delay[threadid];
+        if (thread_state[threadid] != WARMUP) {
+            cycle[threadid]._count += delay[threadid];
+        }
         mpi_pos[threadid] = 1;
     }
-    barrier(threadid);
+    if (thread_state[threadid] != WARMUP) {
+        barrier(threadid);
+        sample(threadid);
+    }
 }
 
 // This routine is executed every time a thread starts.
@@ -287,9 +378,15 @@ void CoreManager::threadStart(THREADID threadid, CONTEXT *ctxt, int32_t flags, v
         cycle[threadid]._count = cycle[0]._count;
     }
     
-    num_threads++; 
     max_threads++; 
-    thread_state[threadid] = ACTIVE;
+    startSample(threadid);
+    if (warmup_ins > 0) {
+        thread_state[threadid] = WARMUP;
+    }
+    else {
+        thread_state[threadid] = ACTIVE;
+        num_threads++; 
+    }
     thread_map[threadid] = PIN_GetTid();
     cout << "[PriME] Thread " << threadid << " begins at cycle "<< (uint64_t)cycle[threadid]._count << endl;
 
@@ -326,7 +423,9 @@ void CoreManager::threadFini(THREADID threadid, const CONTEXT *ctxt, int32_t cod
     }
 
     PIN_GetLock(&thread_lock, threadid+1);
-    num_threads--;
+    if (thread_state[threadid] != WARMUP) {
+        num_threads--;
+    }
     thread_state[threadid] = FINISH;
     cout << "[PriME] Thread " << threadid << " finishes at cycle "<< (uint64_t)cycle[threadid]._count <<endl;
     PIN_ReleaseLock(&thread_lock);
@@ -368,7 +467,7 @@ void CoreManager::sysAfter(ADDRINT ret, THREADID threadid)
         thread_state[threadid] = ACTIVE;
         num_threads++;
     }
-    else {
+    else if (thread_state[threadid] != WARMUP) {
         cycle[threadid]._count += syscall_cost;
     }
     PIN_ReleaseLock(&thread_lock);
@@ -71,7 +71,8 @@ enum ThreadState
     ACTIVE  = 1,
     SUSPEND = 2,
     FINISH  = 3,
-    WAIT    = 4
+    WAIT    = 4,
+    WARMUP  = 5  //functional warmup, not synchronized with other threads
 };
 
 //For futex syscalls
@@ -90,11 +91,12 @@ class CoreManager
         void init(XmlSim* xml_sim, int num_procs_in, int rank_in);
         void getSimStartTime();
         void getSimFinishTime();
+        void initSampling(const char* path);
         void startSim(MPI_Comm *new_comm);
         void finishSim(int32_t code, void *v);
         void insCount(uint32_t ins_count_in, THREADID threadid);
         void execNonMem(uint32_t ins_count_in, THREADID threadid);
-        void execMem(void * addr, THREADID threadid, uint32_t size, bool mem_type);
+        void execMem(void * addr, void * ip, THREADID threadid, uint32_t size, bool mem_type);
         void threadStart(THREADID threadid, CONTEXT *ctxt, int32_t flags, void *v);
         void threadFini(THREADID threadid, const CONTEXT *ctxt, int32_t code, void *v);
         void sysBefore(ADDRINT ip, ADDRINT num, ADDRINT arg0, ADDRINT arg1, ADDRINT arg2, 
@@ -107,11 +109,16 @@ class CoreManager
     private:
         double getAvgCycle(THREADID threadid);
         void barrier(THREADID threadid);
+        void endWarmup(THREADID threadid);
+        void sample(THREADID threadid);
+        void startSample(THREADID threadid);
         struct timespec sim_start_time;
         struct timespec sim_finish_time;
         ThreadData cycle[THREAD_MAX];
         ThreadData ins_nonmem[THREAD_MAX];
         ThreadData ins_count[THREAD_MAX];
+        ThreadData sample_cycle[THREAD_MAX];
+        ThreadData sample_ins[THREAD_MAX];
         MsgMem   *msg_mem[THREAD_MAX];
         int delay[THREAD_MAX];
         int core[THREAD_MAX];
@@ -134,8 +141,12 @@ class CoreManager
         uint32_t thread_sync_interval;
         uint32_t proc_sync_interval;
         uint32_t syscall_cost;
+        uint64_t warmup_ins;
+        uint64_t sample_interval;
+        ofstream sample_file;
         int num_recv_threads;
         PIN_LOCK thread_lock;
+        PIN_LOCK sample_lock;
         PIN_MUTEX mutex;
         PIN_SEMAPHORE sem;
         int rank;
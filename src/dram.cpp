@@ -37,21 +37,39 @@ using namespace std;
 void Dram::init(int access_delay_in)
 {
     access_delay = access_delay_in;
-    num_accesses = 0;
+    stats.init(NUM_DRAM_STATS);
 }
 
 int Dram::access(InsMem * ins_mem)
 {
-    num_accesses++;
+    if (ins_mem->warmup) {
+        return 0;
+    }
+    stats.inc(DRAM_ACCESS);
     return access_delay;
 }
 
 
+uint64_t Dram::getStat(int stat_id)
+{
+    return stats.get(stat_id);
+}
+
 void Dram::report(ofstream* result)
 {
 
     *result << "DRAM Statistics:\n";
-    *result << "Total # of DRAM accesses: " << num_accesses <<endl;
+    *result << "Total # of DRAM accesses: " << stats.get(DRAM_ACCESS) <<endl;
+}
+
+void Dram::save(Checkpoint* ckpt)
+{
+    stats.save(ckpt);
+}
+
+void Dram::restore(Checkpoint* ckpt)
+{
+    stats.restore(ckpt);
 }
 
 Dram::~Dram()
@@ -39,17 +39,27 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <cmath>
 #include "common.h"
 #include "cache.h"
+#include "stats.h"
+
+enum DramStat
+{
+    DRAM_ACCESS = 0,
+    NUM_DRAM_STATS = 1
+};
 
 class Dram
 {
     public:
         void init(int access_delay_in);
         int  access(InsMem* ins_mem);
+        uint64_t getStat(int stat_id);
         void report(ofstream* result);
+        void save(Checkpoint* ckpt);
+        void restore(Checkpoint* ckpt);
         ~Dram();        
     private:
         int access_delay;
-        uint64_t num_accesses;
+        Stats stats;
 };
 
 
@@ -0,0 +1,116 @@
+//===========================================================================
+// histogram.cpp 
+//===========================================================================
+/*
+Copyright (c) 2015 Princeton University
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Princeton University nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY PRINCETON UNIVERSITY "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL PRINCETON UNIVERSITY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cmath>
+#include "histogram.h"
+
+using namespace std;
+
+void Histogram::init()
+{
+    buckets.init(HIST_BUCKETS + 1);
+}
+
+// Smallest value of a bucket
+uint64_t Histogram::getLow(int bucket)
+{
+    int exp;
+    if (bucket < (1 << HIST_SUB_BITS)) {
+        return bucket;
+    }
+    exp = (bucket >> HIST_SUB_BITS) + HIST_SUB_BITS - 1;
+    return (uint64_t)((1 << HIST_SUB_BITS) + (bucket & ((1 << HIST_SUB_BITS) - 1))) << (exp - HIST_SUB_BITS);
+}
+
+// Largest value of a bucket
+uint64_t Histogram::getHigh(int bucket)
+{
+    if (bucket == HIST_BUCKETS - 1) {
+        return UINT64_MAX;
+    }
+    return getLow(bucket + 1) - 1;
+}
+
+uint64_t Histogram::getCount()
+{
+    uint64_t count = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        count += buckets.get(i);
+    }
+    return count;
+}
+
+// Return the largest value of the bucket holding the given percentile, so the
+// result is never below the exact percentile
+uint64_t Histogram::getPercentile(double pct)
+{
+    uint64_t count = getCount();
+    uint64_t rank = (uint64_t)ceil(pct / 100 * count);
+    uint64_t seen = 0;
+    int i;
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (i = 0; i < HIST_BUCKETS; i++) {
+        seen += buckets.get(i);
+        if (seen >= rank) {
+            break;
+        }
+    }
+    return getHigh(i < HIST_BUCKETS ? i : HIST_BUCKETS - 1);
+}
+
+void Histogram::report(ofstream* result, const char* name, bool verbose)
+{
+    uint64_t count = getCount();
+    if (count == 0) {
+        return;
+    }
+    *result << name << ": " << count << " requests, average " << (double)buckets.get(HIST_SUM) / count
+            << ", p50 " << getPercentile(50) << ", p90 " << getPercentile(90)
+            << ", p99 " << getPercentile(99) << ", p999 " << getPercentile(99.9) << endl;
+    if (verbose) {
+        for (int i = 0; i < HIST_BUCKETS; i++) {
+            if (buckets.get(i)) {
+                *result << "    [" << getLow(i) << ", " << getHigh(i) << "]: " << buckets.get(i) << endl;
+            }
+        }
+    }
+}
+
+void Histogram::save(Checkpoint* ckpt)
+{
+    buckets.save(ckpt);
+}
+
+void Histogram::restore(Checkpoint* ckpt)
+{
+    buckets.restore(ckpt);
+}
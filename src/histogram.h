@@ -0,0 +1,88 @@
+//===========================================================================
+// histogram.h 
+//===========================================================================
+/*
+Copyright (c) 2015 Princeton University
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Princeton University nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY PRINCETON UNIVERSITY "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL PRINCETON UNIVERSITY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef  HISTOGRAM_H
+#define  HISTOGRAM_H
+
+#include <inttypes.h>
+#include <fstream>
+#include "stats.h"
+#include "checkpoint.h"
+
+using namespace std;
+
+#define HIST_SUB_BITS   4   //16 buckets per power of two, a bucket spans at most 1/16 of its values
+#define HIST_MAX_BITS   40  //latencies from 2^40 cycles on share the last bucket
+#define HIST_BUCKETS    ((HIST_MAX_BITS - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+#define HIST_SUM        HIST_BUCKETS    //counter holding the sum of all values
+
+
+// A latency histogram with logarithmic buckets in fixed memory. Values below
+// 2^HIST_SUB_BITS get a bucket each, and every further power of two is split
+// into 2^HIST_SUB_BITS buckets, so the relative error of a percentile does
+// not depend on the latency. The buckets are counters of a Stats group, which
+// keeps recording free of locks.
+class Histogram
+{
+    public:
+        void init();
+        void record(uint64_t val);
+        uint64_t getCount();
+        uint64_t getPercentile(double pct);
+        void report(ofstream* result, const char* name, bool verbose);
+        void save(Checkpoint* ckpt);
+        void restore(Checkpoint* ckpt);
+    private:
+        static int getBucket(uint64_t val);
+        static uint64_t getLow(int bucket);
+        static uint64_t getHigh(int bucket);
+        Stats       buckets;
+};
+
+inline int Histogram::getBucket(uint64_t val)
+{
+    int exp;
+    if (val < (1 << HIST_SUB_BITS)) {
+        return (int)val;
+    }
+    exp = 63 - __builtin_clzll(val);
+    if (exp >= HIST_MAX_BITS) {
+        return HIST_BUCKETS - 1;
+    }
+    return ((exp - HIST_SUB_BITS + 1) << HIST_SUB_BITS) + (int)((val >> (exp - HIST_SUB_BITS)) - (1 << HIST_SUB_BITS));
+}
+
+inline void Histogram::record(uint64_t val)
+{
+    buckets.inc(getBucket(val));
+    buckets.add(HIST_SUM, val);
+}
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,262 @@
+//===========================================================================
+// home_alloc.cpp 
+//===========================================================================
+/*
+Copyright (c) 2015 Princeton University
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Princeton University nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY PRINCETON UNIVERSITY "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL PRINCETON UNIVERSITY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <cmath>
+#include "home_alloc.h"
+
+using namespace std;
+
+void HomeAlloc::init(int policy_in, int num_homes_in, uint64_t block_size, uint64_t page_size,
+                     int cluster_width, Network* network)
+{
+    int i, tiles;
+    Coord loc;
+    policy = policy_in;
+    num_homes = num_homes_in;
+    line_bits = (int)log2(block_size);
+    page_bits = (int)log2(page_size);
+    home_bits = (int)ceil(log2(num_homes));
+    home_mask = ((uint64_t)1 << home_bits) - 1;
+    pow2 = ((1 << home_bits) == num_homes);
+    home_table = NULL;
+    num_pages = 0;
+    if (policy == HOME_FIRST_TOUCH || policy == HOME_CLUSTER) {
+        home_table = newTable(HOME_TABLE_SLOTS);
+    }
+    pthread_mutex_init(&mutex, NULL);
+
+    //Nodes are grouped into square tiles of cluster_width x cluster_width
+    //routers on each layer of the mesh
+    if (cluster_width < 1) {
+        cluster_width = 1;
+    }
+    tiles = (network->getNetWidth() + cluster_width - 1) / cluster_width;
+    num_clusters = tiles * tiles * (network->getNetType() == MESH_3D ? network->getNetWidth() : 1);
+    cluster_id = new int [num_homes];
+    cluster_size = new int [num_clusters];
+    cluster_member = new int* [num_clusters];
+    for (i = 0; i < num_clusters; i++) {
+        cluster_size[i] = 0;
+        cluster_member[i] = new int [cluster_width * cluster_width];
+    }
+    for (i = 0; i < num_homes; i++) {
+        loc = network->getLoc(i);
+        cluster_id[i] = (loc.z * tiles + loc.y / cluster_width) * tiles + loc.x / cluster_width;
+        cluster_member[cluster_id[i]][cluster_size[cluster_id[i]]++] = i;
+    }
+}
+
+// Spread consecutive numbers evenly over all homes
+int HomeAlloc::interleave(uint64_t num)
+{
+    if (pow2) {
+        return (int)(num & home_mask);
+    }
+    return (int)(num % num_homes);
+}
+
+HomeTable* HomeAlloc::newTable(uint64_t num_slots)
+{
+    HomeTable* table = new HomeTable;
+    table->mask = num_slots - 1;
+    table->slots = new HomeSlot [num_slots];
+    for (uint64_t i = 0; i < num_slots; i++) {
+        table->slots[i].owner = -1;
+    }
+    return table;
+}
+
+static inline uint64_t hashPage(uint64_t page, int prog_id)
+{
+    uint64_t hash = (page ^ ((uint64_t)prog_id << 48)) * 0x9E3779B97F4A7C15ULL;
+    return hash ^ (hash >> 32);
+}
+
+// This function returns the owner of a page or -1 if it is not in the table.
+// The owner of a slot is written last with a release store, so a slot that
+// is seen as taken already holds its page.
+int HomeAlloc::findOwner(HomeTable* table, uint64_t page, int prog_id)
+{
+    int owner;
+    uint64_t i = hashPage(page, prog_id) & table->mask;
+    while ((owner = __atomic_load_n(&table->slots[i].owner, __ATOMIC_ACQUIRE)) >= 0) {
+        if (table->slots[i].page == page && table->slots[i].prog_id == prog_id) {
+            return owner;
+        }
+        i = (i + 1) & table->mask;
+    }
+    return -1;
+}
+
+void HomeAlloc::insertOwner(HomeTable* table, uint64_t page, int prog_id, int owner)
+{
+    uint64_t i = hashPage(page, prog_id) & table->mask;
+    while (table->slots[i].owner >= 0) {
+        i = (i + 1) & table->mask;
+    }
+    table->slots[i].page = page;
+    table->slots[i].prog_id = prog_id;
+    __atomic_store_n(&table->slots[i].owner, owner, __ATOMIC_RELEASE);
+}
+
+// This function adds the owner of a page, inserts are serialized by the mutex
+// or run before the simulation starts. A table that gets half full is copied
+// into one twice its size, which is then published for the lookups. The old
+// one is kept since lookups may still be probing it.
+void HomeAlloc::addOwner(uint64_t page, int prog_id, int owner)
+{
+    HomeTable* table;
+    if (2 * (num_pages + 1) > home_table->mask + 1) {
+        table = newTable(2 * (home_table->mask + 1));
+        for (uint64_t i = 0; i <= home_table->mask; i++) {
+            if (home_table->slots[i].owner >= 0) {
+                insertOwner(table, home_table->slots[i].page, home_table->slots[i].prog_id,
+                            home_table->slots[i].owner);
+            }
+        }
+        old_tables.push_back(home_table);
+        __atomic_store_n(&home_table, table, __ATOMIC_RELEASE);
+    }
+    insertOwner(home_table, page, prog_id, owner);
+    num_pages++;
+}
+
+void HomeAlloc::freeTables()
+{
+    if (home_table != NULL) {
+        old_tables.push_back(home_table);
+        home_table = NULL;
+    }
+    for (unsigned i = 0; i < old_tables.size(); i++) {
+        delete [] old_tables[i]->slots;
+        delete old_tables[i];
+    }
+    old_tables.clear();
+}
+
+// Return the node that touched the page of this access first, the requester
+// becomes the owner of pages that have not been touched before. Only a miss
+// in the table takes the mutex, which looks the page up again since another
+// thread may have inserted it in the meantime.
+int HomeAlloc::firstTouch(InsMem* ins_mem, int requester)
+{
+    int owner;
+    uint64_t page = ins_mem->addr_dmem >> page_bits;
+    owner = findOwner(__atomic_load_n(&home_table, __ATOMIC_ACQUIRE), page, ins_mem->prog_id);
+    if (owner >= 0) {
+        return owner;
+    }
+    pthread_mutex_lock(&mutex);
+    owner = findOwner(home_table, page, ins_mem->prog_id);
+    if (owner < 0) {
+        owner = requester;
+        addOwner(page, ins_mem->prog_id, owner);
+    }
+    pthread_mutex_unlock(&mutex);
+    return owner;
+}
+
+int HomeAlloc::getHomeId(InsMem* ins_mem, int requester)
+{
+    uint64_t line = ins_mem->addr_dmem >> line_bits;
+    int cluster;
+    switch (policy) {
+        case HOME_PAGE:
+            return interleave(ins_mem->addr_dmem >> page_bits);
+        case HOME_XOR:
+            return interleave(line ^ (line >> home_bits) ^ (line >> (2 * home_bits)));
+        case HOME_FIRST_TOUCH:
+            return firstTouch(ins_mem, requester);
+        case HOME_CLUSTER:
+            cluster = cluster_id[firstTouch(ins_mem, requester)];
+            return cluster_member[cluster][line % cluster_size[cluster]];
+        default:
+            return interleave(line);
+    }
+}
+
+void HomeAlloc::report(ofstream* result)
+{
+    if (policy == HOME_FIRST_TOUCH || policy == HOME_CLUSTER) {
+        *result << "Home allocation:\n";
+        *result << "Total # of pages homed by first touch: " << num_pages << endl;
+        *result << endl;
+    }
+}
+
+// Each first-touch mapping is saved as its program id, page number and owner
+void HomeAlloc::save(Checkpoint* ckpt)
+{
+    uint64_t entry[3];
+    ckpt->write(&num_pages, sizeof(num_pages));
+    if (home_table == NULL) {
+        return;
+    }
+    for (uint64_t i = 0; i <= home_table->mask; i++) {
+        if (home_table->slots[i].owner >= 0) {
+            entry[0] = home_table->slots[i].prog_id;
+            entry[1] = home_table->slots[i].page;
+            entry[2] = home_table->slots[i].owner;
+            ckpt->write(entry, sizeof(entry));
+        }
+    }
+}
+
+// Pages of a checkpoint saved with another home policy are skipped
+void HomeAlloc::restore(Checkpoint* ckpt)
+{
+    uint64_t num_saved;
+    uint64_t entry[3];
+    ckpt->read(&num_saved, sizeof(num_saved));
+    if (home_table != NULL) {
+        freeTables();
+        home_table = newTable(HOME_TABLE_SLOTS);
+        num_pages = 0;
+    }
+    for (uint64_t i = 0; i < num_saved && ckpt->good(); i++) {
+        ckpt->read(entry, sizeof(entry));
+        if (home_table != NULL && findOwner(home_table, entry[1], (int)entry[0]) < 0) {
+            addOwner(entry[1], (int)entry[0], (int)entry[2]);
+        }
+    }
+}
+
+HomeAlloc::~HomeAlloc()
+{
+    for (int i = 0; i < num_clusters; i++) {
+        delete [] cluster_member[i];
+    }
+    delete [] cluster_member;
+    delete [] cluster_size;
+    delete [] cluster_id;
+    freeTables();
+    pthread_mutex_destroy(&mutex);
+}
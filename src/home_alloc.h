@@ -0,0 +1,113 @@
+//===========================================================================
+// home_alloc.h 
+//===========================================================================
+/*
+Copyright (c) 2015 Princeton University
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Princeton University nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY PRINCETON UNIVERSITY "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL PRINCETON UNIVERSITY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef  HOME_ALLOC_H
+#define  HOME_ALLOC_H
+
+#include <inttypes.h>
+#include <fstream>
+#include <vector>
+#include <pthread.h>
+#include "common.h"
+#include "network.h"
+#include "checkpoint.h"
+
+using namespace std;
+
+typedef enum HomePolicy
+{
+    HOME_LINE = 0,
+    HOME_PAGE = 1,
+    HOME_XOR = 2,
+    HOME_FIRST_TOUCH = 3,
+    HOME_CLUSTER = 4
+} HomePolicy;
+
+#define HOME_TABLE_SLOTS 4096    //initial slots of the first-touch table, doubled when half full
+
+// Slot of the first-touch table, which is empty while owner is -1
+typedef struct HomeSlot
+{
+    uint64_t    page;
+    int         prog_id;
+    int         owner;
+} HomeSlot;
+
+// Open-addressing hash table of the first-touch owners with linear probing
+typedef struct HomeTable
+{
+    uint64_t    mask;       //number of slots minus one
+    HomeSlot*   slots;
+} HomeTable;
+
+
+// Maps a memory line to the node that holds its directory entry. Lines can be
+// interleaved over all nodes by line or by page number, hashed by folding the
+// upper line bits in with XOR, homed on the node that touches their page first,
+// or interleaved over the cluster of nodes around that first toucher. Shifts
+// and masks are computed once in init so that the lookup is a few operations.
+// The first-touch owners are looked up without a lock, only the first touch
+// of a page takes the mutex to insert its owner.
+class HomeAlloc
+{
+    public:
+        ~HomeAlloc();
+        void init(int policy_in, int num_homes_in, uint64_t block_size, uint64_t page_size,
+                  int cluster_width, Network* network);
+        int getHomeId(InsMem* ins_mem, int requester);
+        void report(ofstream* result);
+        void save(Checkpoint* ckpt);
+        void restore(Checkpoint* ckpt);
+    private:
+        int interleave(uint64_t num);
+        int firstTouch(InsMem* ins_mem, int requester);
+        HomeTable* newTable(uint64_t num_slots);
+        int findOwner(HomeTable* table, uint64_t page, int prog_id);
+        void insertOwner(HomeTable* table, uint64_t page, int prog_id, int owner);
+        void addOwner(uint64_t page, int prog_id, int owner);
+        void freeTables();
+        int         policy;
+        int         num_homes;
+        int         line_bits;
+        int         page_bits;
+        int         home_bits;
+        uint64_t    home_mask;
+        bool        pow2;
+        int         num_clusters;
+        int*        cluster_id;         //cluster of each node
+        int*        cluster_size;       //number of nodes in each cluster
+        int**       cluster_member;     //nodes of each cluster
+        HomeTable*  home_table;         //first-touch owner of each page
+        vector<HomeTable*> old_tables;  //replaced tables, which lookups may still read
+        uint64_t    num_pages;          //pages homed by first touch
+        pthread_mutex_t mutex;          //taken by inserts only
+};
+
+#endif // HOME_ALLOC_H
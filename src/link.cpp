@@ -41,11 +41,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 using namespace std;
 
-bool Link::init(uint64_t delay_in)
+bool Link::init(uint64_t delay_in, int model_in, uint64_t history_in)
 {
     pthread_mutex_init(&mutex, NULL);
     delay = delay_in;
-    link_queue = QueueModel::create("history_tree", delay);
+    model = model_in;
+    history = history_in;
+    busy_until = 0;
+    link_queue = (model == LINK_BUSY_UNTIL) ? NULL : QueueModel::create("history_tree", delay);
     return true;
 }
 
@@ -53,12 +56,40 @@ bool Link::init(uint64_t delay_in)
 
 uint64_t Link::access(uint64_t timer, int packet_len)
 {
+    if (model == LINK_BUSY_UNTIL) {
+        return (reserve(timer, packet_len) + delay);
+    }
     pthread_mutex_lock(&mutex);
     uint64_t contention_delay = link_queue->computeQueueDelay(timer, packet_len);
     pthread_mutex_unlock(&mutex);
     return (contention_delay + delay);
 }
 
+// This function returns the contention delay of a packet on a busy-until link,
+// which is reserved with a compare-and-swap instead of a lock. A packet that
+// arrives while the link is busy waits until the link is free and extends the
+// busy time by its length. Cores run ahead of each other, so packets do not
+// arrive in time order. A packet more than history cycles behind the busy time
+// is taken to have passed in an idle gap back then. It is neither delayed nor
+// recorded.
+uint64_t Link::reserve(uint64_t timer, int packet_len)
+{
+    uint64_t busy, start;
+    do {
+        busy = busy_until;
+        if (timer >= busy) {
+            start = timer;
+        }
+        else if (busy - timer > history) {
+            return 0;
+        }
+        else {
+            start = busy;
+        }
+    } while (!__sync_bool_compare_and_swap(&busy_until, busy, start + packet_len));
+    return (start - timer);
+}
+
 Link::~Link()
 {
     pthread_mutex_destroy(&mutex);
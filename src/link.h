@@ -37,14 +37,24 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 using namespace std;
 
+enum LinkModel
+{
+    LINK_HISTORY_TREE = 0,
+    LINK_BUSY_UNTIL = 1
+};
+
 class Link
 {
     public:
         ~Link();
-        bool init(uint64_t delay_in);
+        bool init(uint64_t delay_in, int model_in, uint64_t history_in);
         uint64_t access(uint64_t timer, int packet_len);
+        uint64_t reserve(uint64_t timer, int packet_len);
     private:
         uint64_t delay;
+        int model;
+        uint64_t history;
+        volatile uint64_t busy_until;
         pthread_mutex_t mutex;
         QueueModel *link_queue;
 };
@@ -0,0 +1,155 @@
+//===========================================================================
+// mshr.cpp models the miss status holding registers of a cache. 
+//===========================================================================
+/*
+Copyright (c) 2015 Princeton University
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Princeton University nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY PRINCETON UNIVERSITY "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL PRINCETON UNIVERSITY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <inttypes.h>
+
+#include "mshr.h"
+
+
+using namespace std;
+
+bool Mshr::init(int num_entries_in, uint64_t block_size)
+{
+    num_entries = num_entries_in;
+    block_bits = (int) (log2(block_size));
+    last_ready = 0;
+    merge_count = 0;
+    stall_count = 0;
+    stall_cycles = 0;
+    entries = new MshrEntry [num_entries];
+    memset(entries, 0, num_entries * sizeof(MshrEntry));
+    pthread_mutex_init(&mutex, NULL);
+    return true;
+}
+
+// This function allocates an entry to a miss that starts at the start time
+// and would get its data at the finish time. If all entries are busy the miss
+// waits for the earliest one, and the time it waits is returned.
+int Mshr::allocate(uint64_t addr, int64_t start, int64_t finish)
+{
+    int i, stall = 0;
+    MshrEntry* entry;
+
+    pthread_mutex_lock(&mutex);
+    entry = &entries[0];
+    for (i = 1; i < num_entries; i++) {
+        if (entries[i].ready < entry->ready) {
+            entry = &entries[i];
+        }
+    }
+    if (entry->ready > start) {
+        stall = (int)(entry->ready - start);
+        stall_count++;
+        stall_cycles += stall;
+    }
+    entry->line = addr >> block_bits;
+    entry->ready = finish + stall;
+    if (entry->ready > last_ready) {
+        last_ready = entry->ready;
+    }
+    pthread_mutex_unlock(&mutex);
+    return stall;
+}
+
+// This function returns the time an access has to wait for its line if a
+// miss to the line is still outstanding, which merges the access into it
+int Mshr::pending(uint64_t addr, int64_t timer)
+{
+    int i, wait = 0;
+    uint64_t line = addr >> block_bits;
+
+    //Nothing is outstanding once the latest miss has completed
+    if (timer >= last_ready) {
+        return 0;
+    }
+    pthread_mutex_lock(&mutex);
+    for (i = 0; i < num_entries; i++) {
+        if (entries[i].line == line && entries[i].ready > timer) {
+            wait = (int)(entries[i].ready - timer);
+            merge_count++;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+    return wait;
+}
+
+int64_t Mshr::getLastReady()
+{
+    return last_ready;
+}
+
+uint64_t Mshr::getMergeCount()
+{
+    return merge_count;
+}
+
+uint64_t Mshr::getStallCycles()
+{
+    return stall_cycles;
+}
+
+void Mshr::report(ofstream* result)
+{
+    *result << "The # of accesses merged into outstanding misses: " << merge_count << endl;
+    *result << "The # of misses stalled for a free MSHR: " << stall_count << endl;
+    *result << "The # of cycles stalled for a free MSHR: " << stall_cycles << endl;
+}
+
+// Outstanding misses complete at times of the saved run, so only the counters
+// are saved and the entries of a restored MSHR file start free
+void Mshr::save(Checkpoint* ckpt)
+{
+    pthread_mutex_lock(&mutex);
+    ckpt->write(&merge_count, sizeof(merge_count));
+    ckpt->write(&stall_count, sizeof(stall_count));
+    ckpt->write(&stall_cycles, sizeof(stall_cycles));
+    pthread_mutex_unlock(&mutex);
+}
+
+void Mshr::restore(Checkpoint* ckpt)
+{
+    pthread_mutex_lock(&mutex);
+    ckpt->read(&merge_count, sizeof(merge_count));
+    ckpt->read(&stall_count, sizeof(stall_count));
+    ckpt->read(&stall_cycles, sizeof(stall_cycles));
+    last_ready = 0;
+    memset(entries, 0, num_entries * sizeof(MshrEntry));
+    pthread_mutex_unlock(&mutex);
+}
+
+Mshr::~Mshr()
+{
+    pthread_mutex_destroy(&mutex);
+    delete [] entries;
+}
@@ -0,0 +1,76 @@
+//===========================================================================
+// mshr.h 
+//===========================================================================
+/*
+Copyright (c) 2015 Princeton University
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Princeton University nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY PRINCETON UNIVERSITY "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL PRINCETON UNIVERSITY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MSHR_H
+#define MSHR_H
+
+#include <inttypes.h>
+#include <fstream>
+#include <pthread.h>
+#include "checkpoint.h"
+
+using namespace std;
+
+typedef struct MshrEntry
+{
+    uint64_t    line;
+    int64_t     ready;
+} MshrEntry;
+
+// Miss status holding registers of a non-blocking cache. Each entry holds an
+// outstanding miss until its data arrives, a new miss waits for the earliest
+// entry to free up if all of them are busy, and accesses to a line that is
+// still in flight wait for it instead of starting another miss.
+class Mshr
+{
+    public:
+        ~Mshr();
+        bool init(int num_entries_in, uint64_t block_size);
+        int allocate(uint64_t addr, int64_t start, int64_t finish);
+        int pending(uint64_t addr, int64_t timer);
+        int64_t getLastReady();
+        uint64_t getMergeCount();
+        uint64_t getStallCycles();
+        void report(ofstream* result);
+        void save(Checkpoint* ckpt);
+        void restore(Checkpoint* ckpt);
+    private:
+        int         num_entries;
+        int         block_bits;
+        int64_t     last_ready;
+        uint64_t    merge_count;
+        uint64_t    stall_count;
+        uint64_t    stall_cycles;
+        MshrEntry   *entries;
+        pthread_mutex_t mutex;
+};
+
+
+#endif // MSHR_H
@@ -45,7 +45,7 @@ using namespace std;
 
 bool Network::init(int num_nodes_in, XmlNetwork* xml_net)
 {
-    int i, j, k;
+    int i, j, k, pos, sign;
     num_nodes = num_nodes_in;
     net_type = xml_net->net_type;
     if (net_type == MESH_3D) {
@@ -66,7 +66,7 @@ bool Network::init(int num_nodes_in, XmlNetwork* xml_net)
             for (j = 0; j < net_width; j++) {
                 link[i][j] = new Link [3*net_width];
                 for (k = 0; k < 3*net_width; k++) {
-                    link[i][j][k].init(xml_net->link_delay);
+                    link[i][j][k].init(xml_net->link_delay, xml_net->link_model, xml_net->link_history);
                 }
             }
         }
@@ -77,22 +77,69 @@ bool Network::init(int num_nodes_in, XmlNetwork* xml_net)
             link[i] = new Link* [2*net_width];
             for (j = 0; j < 2*net_width; j++) {
                 link[i][j] = new Link();
-                link[i][j]->init(xml_net->link_delay);
+                link[i][j]->init(xml_net->link_delay, xml_net->link_model, xml_net->link_history);
             }
         }
 
     }
-    num_access = 0;
-    total_delay = 0;
-    total_router_delay = 0;
-    total_link_delay = 0;
-    total_inject_delay = 0;
-    total_distance = 0;
-    avg_delay = 0;
-    pthread_mutex_init(&mutex, NULL);
+
+    //Route tables: packets follow dimension-ordered routes, so a route is
+    //walked from node to node by direction without recomputing coordinates
+    num_grid_nodes = (net_type == MESH_3D) ? net_width * net_width * net_width : net_width * net_width;
+    node_loc = new Coord [num_grid_nodes];
+    hop_link = new Link* [num_grid_nodes * NUM_DIRECTIONS];
+    for (i = 0; i < num_grid_nodes; i++) {
+        node_loc[i] = getLoc(i);
+        for (j = 0; j < NUM_DIRECTIONS; j++) {
+            k = j / 2;
+            pos = (k == 0) ? node_loc[i].x : (k == 1) ? node_loc[i].y : node_loc[i].z;
+            sign = (j == EAST || j == SOUTH || j == UP) ? 1 : -1;
+            if (k < getNumDims() && pos + sign >= 0 && pos + sign < net_width) {
+                hop_link[i*NUM_DIRECTIONS + j] = getLink(node_loc[i], (Direction)j);
+            }
+            else {
+                hop_link[i*NUM_DIRECTIONS + j] = NULL;
+            }
+        }
+    }
+    hop_stride[EAST] = 1;
+    hop_stride[WEST] = -1;
+    hop_stride[NORTH] = -net_width;
+    hop_stride[SOUTH] = net_width;
+    hop_stride[UP] = net_width * net_width;
+    hop_stride[DOWN] = -net_width * net_width;
+    for (i = 0; i <= PACKET_TABLE_BYTES; i++) {
+        packet_len_table[i] = header_flits + (i + data_width - 1) / data_width;
+    }
+
+    stats.init(NUM_NETWORK_STATS);
     return true;
 }
 
+// This function returns the # of flits of a packet carrying data_len bytes
+int Network::getPacketLen(int data_len)
+{
+    if (data_len <= PACKET_TABLE_BYTES) {
+        return packet_len_table[data_len];
+    }
+    return header_flits + (data_len + data_width - 1) / data_width;
+}
+
+// This function moves a packet hops steps from node in one direction, adding
+// the router and link delays to timer, and returns the node it arrives at
+int Network::route(int node, Direction direction, int hops, int packet_len, uint64_t* timer)
+{
+    Link** link_cur = &hop_link[node*NUM_DIRECTIONS + direction];
+    int stride = hop_stride[direction] * NUM_DIRECTIONS;
+    for (int k = 0; k < hops; k++) {
+        assert(*link_cur != NULL);
+        *timer += router_delay;
+        *timer += (*link_cur)->access(*timer, packet_len);
+        link_cur += stride;
+    }
+    return node + hops * hop_stride[direction];
+}
+
 //Calculate packet communication latency
 uint64_t Network::transmit(int sender, int receiver, int data_len, uint64_t timer)
 {
@@ -101,65 +148,205 @@ uint64_t Network::transmit(int sender, int receiver, int data_len, uint64_t time
     }
     assert(sender >= 0 && sender < num_nodes);
     assert(receiver >= 0 && receiver < num_nodes);
-    int packet_len = header_flits + (int)ceil((double)data_len/data_width); 
-    Coord loc_sender = getLoc(sender); 
-    Coord loc_receiver = getLoc(receiver); 
-    Coord loc_cur = loc_sender;
-    Direction direction;
+    int packet_len = getPacketLen(data_len);
+    Coord loc_sender = node_loc[sender]; 
+    Coord loc_receiver = node_loc[receiver]; 
+    int node = sender;
+    int hops;
     uint64_t    local_timer = timer;
     uint64_t    local_distance = 0;
-    Link* link_cur;
 
     //Injection delay
     local_timer += inject_delay;
     
-    direction = loc_receiver.x > loc_cur.x ? EAST : WEST;
-    local_distance += abs(loc_receiver.x - loc_cur.x);
-    while (loc_receiver.x != loc_cur.x) {
-        local_timer += router_delay;
-        link_cur = getLink(loc_cur, direction);
-        assert(link_cur != NULL);
-        local_timer += link_cur->access(local_timer, packet_len);
-        loc_cur.x = (direction == EAST) ? (loc_cur.x + 1) : (loc_cur.x - 1);
-    }
+    hops = abs(loc_receiver.x - loc_sender.x);
+    local_distance += hops;
+    node = route(node, loc_receiver.x > loc_sender.x ? EAST : WEST, hops, packet_len, &local_timer);
 
-    direction = loc_receiver.y > loc_cur.y ? SOUTH : NORTH;
-    local_distance += abs(loc_receiver.y - loc_cur.y);
-    while (loc_receiver.y != loc_cur.y) {
-        local_timer += router_delay;
-        link_cur = getLink(loc_cur, direction);
-        assert(link_cur != NULL);
-        local_timer += link_cur->access(local_timer, packet_len);
-        loc_cur.y = (direction == SOUTH) ? (loc_cur.y + 1) : (loc_cur.y - 1);
-    }
+    hops = abs(loc_receiver.y - loc_sender.y);
+    local_distance += hops;
+    node = route(node, loc_receiver.y > loc_sender.y ? SOUTH : NORTH, hops, packet_len, &local_timer);
  
-    direction = loc_receiver.z > loc_cur.z ? UP : DOWN;
-    local_distance += abs(loc_receiver.z - loc_cur.z);
-    while (loc_receiver.z != loc_cur.z) {
-        local_timer += router_delay;
-        link_cur = getLink(loc_cur, direction);
-        assert(link_cur != NULL);
-        local_timer += link_cur->access(local_timer, packet_len);
-        loc_cur.z = (direction == UP) ? (loc_cur.z + 1) : (loc_cur.z - 1);
-    }
+    hops = abs(loc_receiver.z - loc_sender.z);
+    local_distance += hops;
+    node = route(node, loc_receiver.z > loc_sender.z ? UP : DOWN, hops, packet_len, &local_timer);
+    assert(node == receiver);
 
     local_timer += router_delay;
     //Pipe delay 
     local_timer += packet_len - 1; 
  
 
-    pthread_mutex_lock(&mutex);
-    num_access++;
-    total_delay += local_timer - timer;
-    total_router_delay += (local_distance+1) * router_delay;
-    total_link_delay += local_timer - timer - (local_distance+1)*router_delay - (packet_len-1) - inject_delay;
-    total_inject_delay += inject_delay;
-    total_distance += local_distance;
-    pthread_mutex_unlock(&mutex);
+    stats.inc(NET_ACCESS);
+    stats.add(NET_DELAY, local_timer - timer);
+    stats.add(NET_ROUTER_DELAY, (local_distance+1) * router_delay);
+    stats.add(NET_LINK_DELAY, local_timer - timer - (local_distance+1)*router_delay - (packet_len-1) - inject_delay);
+    stats.add(NET_INJECT_DELAY, inject_delay);
+    stats.add(NET_DISTANCE, local_distance);
     return (local_timer - timer);
 }
 
 
+// Multicasts and gathers follow the tree of dimension-ordered routes from one
+// node to all others: a packet travels along X, every node it passes forwards
+// a copy along Y and then along Z, so each link of the tree carries it once.
+// Gathers combine the acknowledgements on the way back along the same tree.
+
+// This function sends a packet from the sender to all nodes, the arrival time
+// at each node is written to arrival. It returns the latency to the last one.
+uint64_t Network::multicast(int sender, int data_len, uint64_t timer, uint64_t* arrival)
+{
+    assert(sender >= 0 && sender < num_nodes);
+    int packet_len = getPacketLen(data_len);
+    uint64_t num_links = 0;
+    uint64_t last;
+
+    arrival[sender] = timer;
+    last = fanOut(sender, 0, timer + inject_delay, packet_len, arrival, &num_links);
+    if (last < timer) {
+        last = timer;
+    }
+
+    stats.inc(NET_MULTICAST);
+    stats.add(NET_MULTICAST_DELAY, last - timer);
+    stats.add(NET_MULTICAST_LINKS, num_links);
+    return (last - timer);
+}
+
+// This function collects a packet from every node to the receiver, the packet
+// of each node is ready at the time given in ready. It returns the time from
+// timer until the receiver has all of them.
+uint64_t Network::gather(int receiver, int data_len, uint64_t timer, uint64_t* ready)
+{
+    assert(receiver >= 0 && receiver < num_nodes);
+    int packet_len = getPacketLen(data_len);
+    uint64_t num_links = 0;
+    uint64_t last, done = ready[receiver];
+
+    if (fanIn(receiver, 0, packet_len, ready, &last, &num_links)
+    &&  last + router_delay + packet_len - 1 > done) {
+        done = last + router_delay + packet_len - 1;
+    }
+    if (done < timer) {
+        done = timer;
+    }
+
+    stats.add(NET_MULTICAST_DELAY, done - timer);
+    stats.add(NET_MULTICAST_LINKS, num_links);
+    return (done - timer);
+}
+
+// This function forwards a packet whose head leaves the router of node at
+// timer along every dimension from dim on, and returns the latest arrival.
+uint64_t Network::fanOut(int node, int dim, uint64_t timer, int packet_len, uint64_t* arrival, uint64_t* num_links)
+{
+    int direction, k, span, stride, node_cur;
+    uint64_t local_timer, last = 0, last_sub;
+    Link** link_cur;
+
+    for (direction = 2 * dim; direction < 2 * getNumDims(); direction++) {
+        span = getSpan(node, (Direction)direction);
+        stride = hop_stride[direction];
+        local_timer = timer;
+        node_cur = node;
+        link_cur = &hop_link[node*NUM_DIRECTIONS + direction];
+        for (k = 0; k < span; k++) {
+            assert(*link_cur != NULL);
+            local_timer += router_delay;
+            local_timer += (*link_cur)->access(local_timer, packet_len);
+            (*num_links)++;
+            node_cur += stride;
+            link_cur += stride * NUM_DIRECTIONS;
+            if (node_cur < num_nodes) {
+                arrival[node_cur] = local_timer + router_delay + packet_len - 1;
+                if (arrival[node_cur] > last) {
+                    last = arrival[node_cur];
+                }
+            }
+            last_sub = fanOut(node_cur, direction / 2 + 1, local_timer, packet_len, arrival, num_links);
+            if (last_sub > last) {
+                last = last_sub;
+            }
+        }
+    }
+    return last;
+}
+
+// This function finds the time the packets of all nodes below node in the
+// tree, along every dimension from dim on, have reached its router.
+// False is returned if there are no such nodes.
+bool Network::fanIn(int node, int dim, int packet_len, uint64_t* ready, uint64_t* last, uint64_t* num_links)
+{
+    int direction, k, span, stride, node_cur;
+    uint64_t local_timer, last_sub;
+    bool found = false, pending;
+    Link** link_cur;
+
+    *last = 0;
+    for (direction = 2 * dim; direction < 2 * getNumDims(); direction++) {
+        span = getSpan(node, (Direction)direction);
+        stride = hop_stride[direction];
+        //The farthest node sends first, each node on the way back
+        //forwards once its own packet and those behind it are ready.
+        //Opposite directions differ in the lowest bit.
+        local_timer = 0;
+        pending = false;
+        node_cur = node + span * stride;
+        link_cur = &hop_link[node_cur*NUM_DIRECTIONS + (direction ^ 1)];
+        for (k = span; k > 0; k--, node_cur -= stride, link_cur -= stride * NUM_DIRECTIONS) {
+            if (node_cur < num_nodes) {
+                if (!pending || ready[node_cur] + inject_delay > local_timer) {
+                    local_timer = ready[node_cur] + inject_delay;
+                }
+                pending = true;
+            }
+            if (fanIn(node_cur, direction / 2 + 1, packet_len, ready, &last_sub, num_links)) {
+                if (!pending || last_sub > local_timer) {
+                    local_timer = last_sub;
+                }
+                pending = true;
+            }
+            if (!pending) {
+                continue;
+            }
+            assert(*link_cur != NULL);
+            local_timer += router_delay;
+            local_timer += (*link_cur)->access(local_timer, packet_len);
+            (*num_links)++;
+        }
+        if (pending && (!found || local_timer > *last)) {
+            *last = local_timer;
+            found = true;
+        }
+    }
+    return found;
+}
+
+int Network::getNumDims()
+{
+    return (net_type == MESH_3D) ? 3 : 2;
+}
+
+// This function returns how many hops the tree extends from node in one
+// direction. Nodes are numbered along the last dimension last, so the tree
+// stops there at the highest node.
+int Network::getSpan(int node, Direction direction)
+{
+    int dim = direction / 2;
+    int pos = (dim == 0) ? node_loc[node].x : (dim == 1) ? node_loc[node].y : node_loc[node].z;
+    int stride = hop_stride[direction];
+    int span = (stride > 0) ? (net_width - 1 - pos) : pos;
+    int limit;
+    if (dim == getNumDims() - 1 && stride > 0) {
+        limit = (node < num_nodes) ? (num_nodes - 1 - node) / stride : 0;
+        if (span > limit) {
+            span = limit;
+        }
+    }
+    return span;
+}
+
+
 Coord Network::getLoc(int node_id)
 {
     Coord loc;
@@ -307,19 +494,45 @@ Link* Network::getLink(Coord node_id, Direction direction)
 }
 
 
-void Network::report(ofstream* result)
+uint64_t Network::getStat(int stat_id)
 {
+    return stats.get(stat_id);
+}
 
-    avg_delay = (double)total_delay / num_access; 
+void Network::report(ofstream* result)
+{
+    uint64_t num_access = stats.get(NET_ACCESS);
+    uint64_t total_delay = stats.get(NET_DELAY);
+    uint64_t total_link_delay = stats.get(NET_LINK_DELAY);
+    uint64_t total_distance = stats.get(NET_DISTANCE);
+    uint64_t num_multicast = stats.get(NET_MULTICAST);
+    double avg_delay = (double)total_delay / num_access; 
     *result << "Network Stat:\n";
     *result << "# of accesses: " << num_access <<endl;
     *result << "Total network communication distance: " << total_distance <<endl;
     *result << "Total network delay: " << total_delay <<endl;
-    *result << "Total router delay: " << total_router_delay <<endl;
+    *result << "Total router delay: " << stats.get(NET_ROUTER_DELAY) <<endl;
     *result << "Total link delay: " << total_link_delay <<endl;
-    *result << "Total inject delay: " << total_inject_delay <<endl;
+    *result << "Total inject delay: " << stats.get(NET_INJECT_DELAY) <<endl;
     *result << "Total contention delay: " << total_link_delay - total_distance*link_delay <<endl;
     *result << "Average network delay: " << avg_delay <<endl <<endl;
+    if (num_multicast > 0) {
+        *result << "# of multicasts: " << num_multicast <<endl;
+        *result << "Total multicast links: " << stats.get(NET_MULTICAST_LINKS) <<endl;
+        *result << "Total multicast delay: " << stats.get(NET_MULTICAST_DELAY) <<endl <<endl;
+    }
+}
+
+// The link queues hold times of the saved run, so only the statistics are
+// saved and the links of a restored network start idle
+void Network::save(Checkpoint* ckpt)
+{
+    stats.save(ckpt);
+}
+
+void Network::restore(Checkpoint* ckpt)
+{
+    stats.restore(ckpt);
 }
 
 Network::~Network()
@@ -344,5 +557,6 @@ Network::~Network()
         delete [] link;
 
     }
-    pthread_mutex_destroy(&mutex);
+    delete [] node_loc;
+    delete [] hop_link;
 }
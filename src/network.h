@@ -39,6 +39,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <pthread.h> 
 #include "link.h"
 #include "cache.h"
+#include "stats.h"
 
 class Link;
 
@@ -51,15 +52,34 @@ enum Direction
     NORTH = 2,
     SOUTH = 3,
     UP = 4,
-    DOWN = 5
+    DOWN = 5,
+    NUM_DIRECTIONS = 6
 };
 
+//Packets of up to this many data bytes take their length from a table
+#define PACKET_TABLE_BYTES 256
+
 enum NetworkType
 {
     MESH_2D = 0,
     MESH_3D = 1
 };
 
+//Counters of the stats group of the network, in checkpoint order
+enum NetworkStat
+{
+    NET_ACCESS = 0,
+    NET_DELAY = 1,
+    NET_ROUTER_DELAY = 2,
+    NET_LINK_DELAY = 3,
+    NET_INJECT_DELAY = 4,
+    NET_DISTANCE = 5,
+    NET_MULTICAST = 6,
+    NET_MULTICAST_DELAY = 7,
+    NET_MULTICAST_LINKS = 8,
+    NUM_NETWORK_STATS = 9
+};
+
 typedef struct Coord
 {
     int x;
@@ -74,14 +94,25 @@ class Network
        ~Network();
        bool init(int num_nodes_in, XmlNetwork* xml_net);
        uint64_t transmit(int sender, int receiver, int data_len, uint64_t timer);
+       uint64_t multicast(int sender, int data_len, uint64_t timer, uint64_t* arrival);
+       uint64_t gather(int receiver, int data_len, uint64_t timer, uint64_t* ready);
        int getNumNodes();
        int getNetType();
        int getNetWidth();
        int getHeaderFlits();
        Coord getLoc(int node_id); 
+       int getPacketLen(int data_len);
+       int route(int node, Direction direction, int hops, int packet_len, uint64_t* timer);
        int getNodeId(Coord loc);
        Link* getLink(Coord node_id, Direction direction);
+       int getNumDims();
+       int getSpan(int node, Direction direction);
+       uint64_t fanOut(int node, int dim, uint64_t timer, int packet_len, uint64_t* arrival, uint64_t* num_links);
+       bool fanIn(int node, int dim, int packet_len, uint64_t* ready, uint64_t* last, uint64_t* num_links);
+       uint64_t getStat(int stat_id);
        void report(ofstream* result);
+       void save(Checkpoint* ckpt);
+       void restore(Checkpoint* ckpt);
    private:
        int net_type;
        int num_nodes;
@@ -92,14 +123,12 @@ class Network
        uint64_t link_delay;
        uint64_t inject_delay;
        Link*** link;
-       uint64_t num_access;
-       uint64_t total_delay;
-       uint64_t total_router_delay;
-       uint64_t total_link_delay;
-       uint64_t total_inject_delay;
-       uint64_t total_distance;
-       double avg_delay;
-       pthread_mutex_t mutex;
+       int num_grid_nodes;
+       Coord* node_loc;     //coordinates of every node of the grid
+       Link** hop_link;     //link leaving every node of the grid in each direction, NULL at the edges
+       int hop_stride[NUM_DIRECTIONS];
+       int packet_len_table[PACKET_TABLE_BYTES+1];
+       Stats stats;
         
 };
 
@@ -86,6 +86,34 @@ void PageTable::report(ofstream* result)
     }
 }
 
+// Each mapping is saved as its program id, virtual and physical page numbers
+void PageTable::save(Checkpoint* ckpt)
+{
+    uint64_t num_pages = page_map.size();
+    uint64_t entry[3];
+    ckpt->write(&empty_page_num, sizeof(empty_page_num));
+    ckpt->write(&num_pages, sizeof(num_pages));
+    for (PageMap::iterator it = page_map.begin(); it != page_map.end(); ++it) {
+        entry[0] = it->first.first;
+        entry[1] = it->first.second;
+        entry[2] = it->second;
+        ckpt->write(entry, sizeof(entry));
+    }
+}
+
+void PageTable::restore(Checkpoint* ckpt)
+{
+    uint64_t num_pages;
+    uint64_t entry[3];
+    page_map.clear();
+    ckpt->read(&empty_page_num, sizeof(empty_page_num));
+    ckpt->read(&num_pages, sizeof(num_pages));
+    for (uint64_t i = 0; i < num_pages && ckpt->good(); i++) {
+        ckpt->read(entry, sizeof(entry));
+        page_map[UKey((int)entry[0], entry[1])] = entry[2];
+    }
+}
+
 PageTable::~PageTable()
 {
     pthread_mutex_destroy(lock);
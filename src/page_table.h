@@ -57,6 +57,8 @@ class PageTable
         uint64_t translate(InsMem* ins_mem);
         int getTransDelay();
         void report(ofstream* result);
+        void save(Checkpoint* ckpt);
+        void restore(Checkpoint* ckpt);
         IntSet prog_set;
         ~PageTable();        
     private:
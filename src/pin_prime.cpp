@@ -47,9 +47,9 @@ void PIN_FAST_ANALYSIS_CALL execNonMem(uint32_t ins_count, THREADID threadid)
 
 
 // Handle a memory instruction
-void execMem(void * addr, THREADID threadid, uint32_t size, bool mem_type)
+void execMem(void * addr, void * ip, THREADID threadid, uint32_t size, bool mem_type)
 {
-    core_manager->execMem(addr, threadid, size, mem_type);
+    core_manager->execMem(addr, ip, threadid, size, mem_type);
 }
 
 // This routine is executed every time a thread starts.
@@ -130,6 +130,7 @@ void Trace(TRACE trace, void *v)
                         INS_InsertPredicatedCall(
                             ins, IPOINT_BEFORE, (AFUNPTR)execMem,
                             IARG_MEMORYOP_EA, memOp,
+                            IARG_INST_PTR,
                             IARG_THREAD_ID,
                             IARG_UINT32, size,
                             IARG_BOOL, RD,
@@ -140,6 +141,7 @@ void Trace(TRACE trace, void *v)
                         INS_InsertPredicatedCall(
                             ins, IPOINT_BEFORE, (AFUNPTR)execMem,
                             IARG_MEMORYOP_EA, memOp,
+                            IARG_INST_PTR,
                             IARG_THREAD_ID,
                             IARG_UINT32, size,
                             IARG_BOOL, WR,
@@ -239,6 +241,11 @@ int main(int argc, char *argv[])
     core_manager = new CoreManager;
     //# of core processes equals num_tasks-1 because there is a uncore process
     core_manager->init(xml_sim, num_tasks-1, myrank);
+    if (xml_sim->sample_interval > 0) {
+        stringstream ss_rank;
+        ss_rank << myrank;
+        core_manager->initSampling((KnobOutputFile.Value() + "_" + ss_rank.str() + "_samples.csv").c_str());
+    }
     core_manager->getSimStartTime();
 
  
@@ -0,0 +1,413 @@
+//===========================================================================
+// prefetcher.cpp implements the hardware prefetchers of a data cache. 
+//===========================================================================
+/*
+Copyright (c) 2015 Princeton University
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Princeton University nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY PRINCETON UNIVERSITY "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL PRINCETON UNIVERSITY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <cstring>
+#include <inttypes.h>
+#include <cmath>
+#include <assert.h>
+
+#include "prefetcher.h"
+#include "stats.h"
+
+using namespace std;
+
+#define STRIDE_ENTRIES  64    // default size of the stride table
+#define STRIDE_CONF_MAX 3
+#define STRIDE_CONF_HIT 2     // a stride is prefetched once it repeated twice
+#define STREAM_ENTRIES  8     // default # of stream buffers
+#define STREAM_CONF_MAX 3
+
+
+Prefetcher* Prefetcher::create(XmlCache* xml_cache)
+{
+    switch (xml_cache->prefetcher) {
+        case PREFETCH_NONE:
+            return NULL;
+        case PREFETCH_NEXT_LINE:
+            return new NextLinePrefetcher(xml_cache);
+        case PREFETCH_STRIDE:
+            return new StridePrefetcher(xml_cache);
+        case PREFETCH_STREAM:
+            return new StreamPrefetcher(xml_cache);
+        default:
+            cerr << "Error: Undefined prefetcher " << xml_cache->prefetcher << "!\n";
+            assert(false);
+            return NULL;
+    }
+}
+
+Prefetcher::Prefetcher(XmlCache* xml_cache)
+{
+    degree = xml_cache->prefetch_degree;
+    if (degree < 1 || degree > PREFETCH_MAX_DEGREE) {
+        cerr << "Warning: The prefetch degree must be between 1 and " << PREFETCH_MAX_DEGREE << "!\n";
+        degree = (degree < 1) ? 1 : PREFETCH_MAX_DEGREE;
+    }
+    num_entries = xml_cache->prefetch_entries;
+    block_bits = (int) (log2(xml_cache->block_size));
+    issued_count = 0;
+    useful_count = 0;
+    late_count = 0;
+    polluting_count = 0;
+    memset(inflight, 0, sizeof(inflight));
+    memset(victims, 0, sizeof(victims));
+    pthread_mutex_init(&mutex, NULL);
+}
+
+Prefetcher::~Prefetcher()
+{
+    pthread_mutex_destroy(&mutex);
+}
+
+// This function trains the prefetcher with a demand access and returns the #
+// of prefetch candidates written into pf_addr
+int Prefetcher::train(uint64_t addr, uint64_t ip, int event, uint64_t* pf_addr)
+{
+    int i, num_pf;
+    uint64_t pf_line[PREFETCH_MAX_DEGREE];
+
+    pthread_mutex_lock(&mutex);
+    num_pf = predict(addr >> block_bits, ip, event, pf_line);
+    pthread_mutex_unlock(&mutex);
+    for (i = 0; i < num_pf; i++) {
+        pf_addr[i] = pf_line[i] << block_bits;
+    }
+    return num_pf;
+}
+
+// This function records a prefetch whose data arrives at the ready time
+void Prefetcher::issue(uint64_t addr, int64_t ready)
+{
+    uint64_t line = addr >> block_bits;
+    pthread_mutex_lock(&mutex);
+    if (!stat_warmup) {
+        issued_count++;
+    }
+    inflight[line % PREFETCH_INFLIGHT].line = line;
+    inflight[line % PREFETCH_INFLIGHT].ready = ready;
+    pthread_mutex_unlock(&mutex);
+}
+
+// This function records the first demand hit to a prefetched line and returns
+// the cycles left until the prefetch completes, which is 0 unless it is late
+int Prefetcher::useful(uint64_t addr, int64_t timer)
+{
+    int wait = 0;
+    uint64_t line = addr >> block_bits;
+    InflightEntry* entry = &inflight[line % PREFETCH_INFLIGHT];
+
+    pthread_mutex_lock(&mutex);
+    if (!stat_warmup) {
+        useful_count++;
+    }
+    if (entry->line == line && entry->ready > timer) {
+        if (!stat_warmup) {
+            late_count++;
+        }
+        wait = (int)(entry->ready - timer);
+    }
+    entry->ready = 0;
+    pthread_mutex_unlock(&mutex);
+    return wait;
+}
+
+// This function records a line evicted by a prefetch fill, 0 marks an empty
+// entry so line addresses are stored plus one
+void Prefetcher::evict(uint64_t addr)
+{
+    uint64_t line = addr >> block_bits;
+    victims[line % PREFETCH_VICTIMS] = line + 1;
+}
+
+// This function counts a polluting prefetch if a demand miss hits a line
+// evicted by a prefetch fill
+void Prefetcher::demandMiss(uint64_t addr)
+{
+    uint64_t line = addr >> block_bits;
+    if (victims[line % PREFETCH_VICTIMS] == line + 1) {
+        victims[line % PREFETCH_VICTIMS] = 0;
+        if (!stat_warmup) {
+            __sync_fetch_and_add(&polluting_count, 1);
+        }
+    }
+}
+
+uint64_t Prefetcher::getIssuedCount()
+{
+    return issued_count;
+}
+
+uint64_t Prefetcher::getUsefulCount()
+{
+    return useful_count;
+}
+
+uint64_t Prefetcher::getLateCount()
+{
+    return late_count;
+}
+
+uint64_t Prefetcher::getPollutingCount()
+{
+    return polluting_count;
+}
+
+void Prefetcher::report(ofstream* result)
+{
+    *result << "The # of issued prefetches: " << issued_count << endl;
+    *result << "The # of useful prefetches: " << useful_count << endl;
+    *result << "The # of late prefetches: " << late_count << endl;
+    *result << "The # of polluting prefetches: " << polluting_count << endl;
+}
+
+// Prefetches in flight complete at times of the saved run, so they are not
+// saved and a restored prefetcher starts with none
+void Prefetcher::save(Checkpoint* ckpt)
+{
+    pthread_mutex_lock(&mutex);
+    ckpt->write(&issued_count, sizeof(issued_count));
+    ckpt->write(&useful_count, sizeof(useful_count));
+    ckpt->write(&late_count, sizeof(late_count));
+    ckpt->write(&polluting_count, sizeof(polluting_count));
+    ckpt->write(victims, sizeof(victims));
+    saveTable(ckpt);
+    pthread_mutex_unlock(&mutex);
+}
+
+void Prefetcher::restore(Checkpoint* ckpt)
+{
+    pthread_mutex_lock(&mutex);
+    ckpt->read(&issued_count, sizeof(issued_count));
+    ckpt->read(&useful_count, sizeof(useful_count));
+    ckpt->read(&late_count, sizeof(late_count));
+    ckpt->read(&polluting_count, sizeof(polluting_count));
+    memset(inflight, 0, sizeof(inflight));
+    ckpt->read(victims, sizeof(victims));
+    restoreTable(ckpt);
+    pthread_mutex_unlock(&mutex);
+}
+
+void Prefetcher::saveTable(Checkpoint* ckpt)
+{
+}
+
+void Prefetcher::restoreTable(Checkpoint* ckpt)
+{
+}
+
+
+
+// The next-line prefetcher fetches the following lines upon a miss or a first
+// hit to a prefetched line, so a sequential stream keeps it ahead.
+NextLinePrefetcher::NextLinePrefetcher(XmlCache* xml_cache) : Prefetcher(xml_cache)
+{
+}
+
+int NextLinePrefetcher::predict(uint64_t line, uint64_t ip, int event, uint64_t* pf_line)
+{
+    if (event != PF_MISS && event != PF_HIT_PREFETCHED) {
+        return 0;
+    }
+    for (int i = 0; i < degree; i++) {
+        pf_line[i] = line + i + 1;
+    }
+    return degree;
+}
+
+
+
+// The stride prefetcher keeps the last line and stride of each instruction
+// pointer in a direct-mapped table. A stride is prefetched after it repeated
+// twice, and a mismatch first lowers the confidence before it is replaced.
+StridePrefetcher::StridePrefetcher(XmlCache* xml_cache) : Prefetcher(xml_cache)
+{
+    if (num_entries <= 0) {
+        num_entries = STRIDE_ENTRIES;
+    }
+    table = new StrideEntry [num_entries];
+    memset(table, 0, num_entries * sizeof(StrideEntry));
+}
+
+StridePrefetcher::~StridePrefetcher()
+{
+    delete [] table;
+}
+
+void StridePrefetcher::saveTable(Checkpoint* ckpt)
+{
+    ckpt->write(table, num_entries * sizeof(StrideEntry));
+}
+
+void StridePrefetcher::restoreTable(Checkpoint* ckpt)
+{
+    ckpt->read(table, num_entries * sizeof(StrideEntry));
+}
+
+int StridePrefetcher::predict(uint64_t line, uint64_t ip, int event, uint64_t* pf_line)
+{
+    int i;
+    int64_t delta;
+    StrideEntry* entry = &table[(ip ^ (ip >> 16)) % num_entries];
+
+    if (entry->ip != ip) {
+        entry->ip = ip;
+        entry->last_line = line;
+        entry->stride = 0;
+        entry->conf = 0;
+        return 0;
+    }
+    delta = (int64_t)(line - entry->last_line);
+    if (delta == 0) {
+        return 0;
+    }
+    if (delta == entry->stride) {
+        if (entry->conf < STRIDE_CONF_MAX) {
+            entry->conf++;
+        }
+    }
+    else if (entry->conf > 0) {
+        entry->conf--;
+    }
+    else {
+        entry->stride = delta;
+    }
+    entry->last_line = line;
+
+    if (entry->conf < STRIDE_CONF_HIT) {
+        return 0;
+    }
+    for (i = 0; i < degree; i++) {
+        pf_line[i] = line + entry->stride * (i + 1);
+    }
+    return degree;
+}
+
+
+
+// Each stream buffer follows misses that are within a window of its last line.
+// The second miss of a stream sets its direction, and from then on every miss
+// or first hit to a prefetched line keeps the stream degree lines ahead.
+// Lines already requested by a stream are not requested again.
+StreamPrefetcher::StreamPrefetcher(XmlCache* xml_cache) : Prefetcher(xml_cache)
+{
+    if (num_entries <= 0) {
+        num_entries = STREAM_ENTRIES;
+    }
+    streams = new StreamEntry [num_entries];
+    memset(streams, 0, num_entries * sizeof(StreamEntry));
+    clock = 0;
+}
+
+StreamPrefetcher::~StreamPrefetcher()
+{
+    delete [] streams;
+}
+
+void StreamPrefetcher::saveTable(Checkpoint* ckpt)
+{
+    ckpt->write(&clock, sizeof(clock));
+    ckpt->write(streams, num_entries * sizeof(StreamEntry));
+}
+
+void StreamPrefetcher::restoreTable(Checkpoint* ckpt)
+{
+    ckpt->read(&clock, sizeof(clock));
+    ckpt->read(streams, num_entries * sizeof(StreamEntry));
+}
+
+int StreamPrefetcher::predict(uint64_t line, uint64_t ip, int event, uint64_t* pf_line)
+{
+    int i, dir, num_pf = 0;
+    int64_t delta;
+    uint64_t start, end;
+    StreamEntry* stream = NULL;
+
+    if (event != PF_MISS && event != PF_HIT_PREFETCHED) {
+        return 0;
+    }
+    clock++;
+    for (i = 0; i < num_entries; i++) {
+        delta = (int64_t)(line - streams[i].last_line);
+        if (streams[i].lru && delta >= -STREAM_WINDOW && delta <= STREAM_WINDOW) {
+            stream = &streams[i];
+            break;
+        }
+    }
+
+    //Allocate the least recently used stream
+    if (stream == NULL) {
+        stream = &streams[0];
+        for (i = 1; i < num_entries; i++) {
+            if (streams[i].lru < stream->lru) {
+                stream = &streams[i];
+            }
+        }
+        stream->last_line = line;
+        stream->next_line = line;
+        stream->dir = 0;
+        stream->conf = 0;
+        stream->lru = clock;
+        return 0;
+    }
+
+    stream->lru = clock;
+    if (delta == 0) {
+        return 0;
+    }
+    dir = (delta > 0) ? 1 : -1;
+    if (dir == stream->dir) {
+        if (stream->conf < STREAM_CONF_MAX) {
+            stream->conf++;
+        }
+    }
+    else {
+        stream->dir = dir;
+        stream->conf = 1;
+        stream->next_line = line;
+    }
+    stream->last_line = line;
+    if (dir < 0 && line <= (uint64_t)degree) {
+        return 0;
+    }
+
+    start = line + dir;
+    end = line + dir * degree;
+    if ((dir > 0 && stream->next_line > start) || (dir < 0 && stream->next_line < start)) {
+        start = stream->next_line;
+    }
+    for (uint64_t pf = start; (dir > 0) ? (pf <= end) : (pf >= end); pf += dir) {
+        pf_line[num_pf++] = pf;
+    }
+    if (num_pf > 0) {
+        stream->next_line = end + dir;
+    }
+    return num_pf;
+}
@@ -0,0 +1,164 @@
+//===========================================================================
+// prefetcher.h 
+//===========================================================================
+/*
+Copyright (c) 2015 Princeton University
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Princeton University nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY PRINCETON UNIVERSITY "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL PRINCETON UNIVERSITY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef  PREFETCHER_H
+#define  PREFETCHER_H
+
+#include <inttypes.h>
+#include <fstream>
+#include <pthread.h>
+#include "xml_parser.h"
+#include "checkpoint.h"
+
+using namespace std;
+
+#define PREFETCH_MAX_DEGREE  16    // at most 16 prefetches per trigger
+#define PREFETCH_INFLIGHT    64    // in-flight prefetches tracked to detect late ones
+#define PREFETCH_VICTIMS     1024  // victims of prefetch fills tracked to detect pollution
+#define STREAM_WINDOW        16    // a miss within 16 lines of a stream advances it
+
+typedef enum PrefetchType
+{
+    PREFETCH_NONE       = 0, //no prefetcher
+    PREFETCH_NEXT_LINE  = 1, //next lines upon a miss or a first hit to a prefetched line
+    PREFETCH_STRIDE     = 2, //stride detected per instruction pointer
+    PREFETCH_STREAM     = 3  //stream buffers following ascending or descending misses
+} PrefetchType;
+
+typedef enum PrefetchEvent
+{
+    PF_NONE             = 0, //the cache was not accessed by the demand
+    PF_MISS             = 1, //demand miss
+    PF_HIT              = 2, //demand hit
+    PF_HIT_PREFETCHED   = 3  //first demand hit to a prefetched line
+} PrefetchEvent;
+
+typedef struct InflightEntry
+{
+    uint64_t    line;
+    int64_t     ready;
+} InflightEntry;
+
+
+// A prefetcher is attached to one data cache and trained by the demand
+// accesses to that cache. Prefetch candidates are returned to the system,
+// which issues them through the coherence protocol like demand reads.
+// The prefetcher also keeps track of its prefetches to count the useful ones,
+// the late ones still in flight when they are used, and the polluting ones
+// whose fill evicted a line that misses again later.
+class Prefetcher
+{
+    public:
+        static Prefetcher* create(XmlCache* xml_cache);
+        virtual ~Prefetcher();
+        int train(uint64_t addr, uint64_t ip, int event, uint64_t* pf_addr);
+        void issue(uint64_t addr, int64_t ready);
+        int useful(uint64_t addr, int64_t timer);
+        void evict(uint64_t addr);
+        void demandMiss(uint64_t addr);
+        uint64_t getIssuedCount();
+        uint64_t getUsefulCount();
+        uint64_t getLateCount();
+        uint64_t getPollutingCount();
+        void report(ofstream* result);
+        void save(Checkpoint* ckpt);
+        void restore(Checkpoint* ckpt);
+    protected:
+        Prefetcher(XmlCache* xml_cache);
+        virtual int predict(uint64_t line, uint64_t ip, int event, uint64_t* pf_line) = 0;
+        virtual void saveTable(Checkpoint* ckpt);
+        virtual void restoreTable(Checkpoint* ckpt);
+        int         degree;
+        int         num_entries;
+    private:
+        int         block_bits;
+        uint64_t    issued_count;
+        uint64_t    useful_count;
+        uint64_t    late_count;
+        uint64_t    polluting_count;
+        InflightEntry inflight[PREFETCH_INFLIGHT];
+        uint64_t    victims[PREFETCH_VICTIMS];
+        pthread_mutex_t mutex;
+};
+
+class NextLinePrefetcher : public Prefetcher
+{
+    public:
+        NextLinePrefetcher(XmlCache* xml_cache);
+    protected:
+        int predict(uint64_t line, uint64_t ip, int event, uint64_t* pf_line);
+};
+
+typedef struct StrideEntry
+{
+    uint64_t    ip;
+    uint64_t    last_line;
+    int64_t     stride;
+    int         conf;
+} StrideEntry;
+
+class StridePrefetcher : public Prefetcher
+{
+    public:
+        StridePrefetcher(XmlCache* xml_cache);
+        ~StridePrefetcher();
+    protected:
+        int predict(uint64_t line, uint64_t ip, int event, uint64_t* pf_line);
+        void saveTable(Checkpoint* ckpt);
+        void restoreTable(Checkpoint* ckpt);
+    private:
+        StrideEntry *table;
+};
+
+typedef struct StreamEntry
+{
+    uint64_t    last_line;
+    uint64_t    next_line;
+    int         dir;
+    int         conf;
+    uint64_t    lru;
+} StreamEntry;
+
+class StreamPrefetcher : public Prefetcher
+{
+    public:
+        StreamPrefetcher(XmlCache* xml_cache);
+        ~StreamPrefetcher();
+    protected:
+        int predict(uint64_t line, uint64_t ip, int event, uint64_t* pf_line);
+        void saveTable(Checkpoint* ckpt);
+        void restoreTable(Checkpoint* ckpt);
+    private:
+        StreamEntry *streams;
+        uint64_t    clock;
+};
+
+
+#endif // PREFETCHER_H
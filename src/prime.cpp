@@ -49,6 +49,8 @@ void *msgHandler(void *t)
     memset(msg_mem[0], 0, (max_msg_size + 1)*sizeof(MsgMem));
     memset(msg_mem[1], 0, (max_msg_size + 1)*sizeof(MsgMem));
     memset(&ins_mem, 0, sizeof(ins_mem));
+    //Run next to the caches of the cores this thread serves if they were built upfront
+    uncore_manager.bindThread((int)rec_thread, num_threads);
     while (1) {
         MPI_Recv(msg_mem[index_prev], (max_msg_size + 1)*sizeof(MsgMem), MPI_CHAR, MPI_ANY_SOURCE, (int)rec_thread , MPI_COMM_WORLD, &local_status);
         //Receive a msg indicating a new process
@@ -123,9 +125,12 @@ void *msgHandler(void *t)
             delay = 0;
             core_id = uncore_manager.getCoreId(local_status.MPI_SOURCE, thread_id);
             ins_mem.prog_id = local_status.MPI_SOURCE;
+            ins_mem.prefetch = false;
             for(int i = 1; i < msg_len; i++) {
                 ins_mem.mem_type = msg_mem[index_prev][i].mem_type;
                 ins_mem.addr_dmem = msg_mem[index_prev][i].addr_dmem;
+                ins_mem.addr_ins = msg_mem[index_prev][i].addr_ins;
+                ins_mem.warmup = msg_mem[index_prev][i].warmup;
                 delay += uncore_manager.uncore_access(core_id, &ins_mem, msg_mem[index_prev][i].timer + delay) - 1;
                 if (delay < 0) {
                     cerr<<"Error: negative delay: "<<core_id<<" "<<ins_mem.prog_id<<" "<<thread_id<<" "
@@ -133,6 +138,10 @@ void *msgHandler(void *t)
                     pthread_exit(NULL);
                 }
             }
+            //Wait for the misses still outstanding at the end of the batch
+            if (msg_len > 1) {
+                delay += uncore_manager.uncore_drain(core_id, msg_mem[index_prev][msg_len-1].timer + delay + 1);
+            }
             MPI_Send(&delay, 1, MPI_INT, local_status.MPI_SOURCE , thread_id, MPI_COMM_WORLD);
         }
     }
@@ -196,6 +205,11 @@ int main(int argc, char *argv[])
     max_msg_size = xml_sim->max_msg_size;
     num_threads = xml_sim->num_recv_threads;
     uncore_manager.init(xml_sim);
+    if (!xml_sim->checkpoint_restore.empty()
+     && !uncore_manager.restoreCheckpoint(xml_sim->checkpoint_restore.c_str())) {
+        MPI_Abort(MPI_COMM_WORLD, -1);
+        return -1;
+    }
     pthread_mutex_init(&mutex, NULL);
     pthread_attr_init(&attr);
     pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
@@ -203,6 +217,9 @@ int main(int argc, char *argv[])
     stringstream ss_rank;
     ss_rank << myrank;
     result.open((string(argv[2])+ "_" + ss_rank.str()).c_str());
+    if (xml_sim->sample_interval > 0) {
+        uncore_manager.initSampling((string(argv[2]) + "_" + ss_rank.str() + "_samples.csv").c_str(), xml_sim->sample_interval);
+    }
 
     uncore_manager.getSimStartTime();
     for(t = 0; t < num_threads; t++) {
@@ -230,8 +247,13 @@ int main(int argc, char *argv[])
     }
       
     uncore_manager.getSimFinishTime();
+    uncore_manager.finishSampling();
+    if (!xml_sim->checkpoint_save.empty()) {
+        uncore_manager.saveCheckpoint(xml_sim->checkpoint_save.c_str());
+    }
     uncore_manager.report(&result);
     result.close();
+    uncore_manager.dumpSetStats((string(argv[2]) + "_" + ss_rank.str() + "_sets.csv").c_str());
     MPI_Finalize();
     pthread_mutex_destroy(&mutex);
     pthread_exit(NULL);
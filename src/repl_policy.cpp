@@ -0,0 +1,464 @@
+//===========================================================================
+// repl_policy.cpp implements the replacement policies of a cache set. 
+//===========================================================================
+/*
+Copyright (c) 2015 Princeton University
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Princeton University nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY PRINCETON UNIVERSITY "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL PRINCETON UNIVERSITY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <cstring>
+#include <inttypes.h>
+#include <assert.h>
+
+#include "repl_policy.h"
+
+using namespace std;
+
+#define RRPV_BITS       2
+#define RRPV_MAX        ((1 << RRPV_BITS) - 1)
+#define RRPV_LONG       (RRPV_MAX - 1)
+#define BRRIP_EPSILON   32    // BRRIP inserts with a long interval once every 32 fills
+#define PSEL_BITS       10
+#define LEADER_BITS     5     // one SRRIP and one BRRIP leader set out of every 32 sets
+
+typedef enum LeaderType
+{
+    FOLLOWER      = 0,
+    SRRIP_LEADER  = 1,
+    BRRIP_LEADER  = 2
+} LeaderType;
+
+
+ReplPolicy* ReplPolicy::create(int repl_type, int num_ways_in, uint64_t num_sets_in)
+{
+    switch (repl_type) {
+        case REPL_LRU:
+            return new LruPolicy(num_ways_in, num_sets_in);
+        case REPL_TREE_PLRU:
+            return new TreePlruPolicy(num_ways_in, num_sets_in);
+        case REPL_NRU:
+            return new NruPolicy(num_ways_in, num_sets_in);
+        case REPL_SRRIP:
+        case REPL_BRRIP:
+        case REPL_DRRIP:
+            return new RripPolicy(repl_type, num_ways_in, num_sets_in);
+        case REPL_RANDOM:
+            return new RandomPolicy(num_ways_in, num_sets_in);
+        default:
+            cerr << "Error: Undefined replacement policy " << repl_type << "!\n";
+            assert(false);
+            return NULL;
+    }
+}
+
+// Per-set state is saved with the set records of the cache, so only policies
+// with global state need to save anything
+void ReplPolicy::save(Checkpoint* ckpt)
+{
+}
+
+void ReplPolicy::restore(Checkpoint* ckpt)
+{
+}
+
+ReplPolicy::~ReplPolicy()
+{
+}
+
+
+
+// LRU keeps the recency rank of each way in one byte, the most recently used
+// way has age 0 and the victim is the way with the largest age.
+LruPolicy::LruPolicy(int num_ways_in, uint64_t num_sets_in)
+{
+    num_ways = num_ways_in;
+    num_sets = num_sets_in;
+}
+
+int LruPolicy::getSetBytes()
+{
+    return num_ways;
+}
+
+void LruPolicy::initSet(uint8_t* repl, uint64_t index)
+{
+    for (int i = 0; i < num_ways; i++) {
+        repl[i] = i;
+    }
+}
+
+void LruPolicy::touch(uint8_t* repl, uint64_t index, int way)
+{
+    uint8_t age_old = repl[way];
+    for (int i = 0; i < num_ways; i++) {
+        if (repl[i] < age_old) {
+            repl[i]++;
+        }
+    }
+    repl[way] = 0;
+}
+
+void LruPolicy::insert(uint8_t* repl, uint64_t index, int way)
+{
+    touch(repl, index, way);
+}
+
+int LruPolicy::victim(uint8_t* repl, uint64_t index)
+{
+    int max_age = 0;
+    for (int i = 1; i < num_ways; i++) {
+        if (repl[i] > repl[max_age]) {
+            max_age = i;
+        }
+    }
+    return max_age;
+}
+
+int LruPolicy::rank(uint8_t* repl, uint64_t index, int way)
+{
+    return repl[way];
+}
+
+
+
+// Tree-PLRU keeps one bit per inner node of a binary tree over the ways,
+// rounded up to a power of two. Node n has children 2n and 2n+1, and its bit
+// points to the half holding the next victim.
+TreePlruPolicy::TreePlruPolicy(int num_ways_in, uint64_t num_sets_in)
+{
+    num_ways = num_ways_in;
+    num_sets = num_sets_in;
+    num_leaves = 1;
+    while (num_leaves < num_ways) {
+        num_leaves <<= 1;
+    }
+}
+
+int TreePlruPolicy::getSetBytes()
+{
+    return (num_leaves - 1 + 7) / 8;
+}
+
+void TreePlruPolicy::initSet(uint8_t* repl, uint64_t index)
+{
+    memset(repl, 0, getSetBytes());
+}
+
+void TreePlruPolicy::touch(uint8_t* repl, uint64_t index, int way)
+{
+    int node = 1;
+    for (int half = num_leaves >> 1; half > 0; half >>= 1) {
+        int dir = (way & half) ? 1 : 0;
+        //Point the node away from the way just used
+        if (dir) {
+            repl[(node-1) >> 3] &= ~(1 << ((node-1) & 7));
+        }
+        else {
+            repl[(node-1) >> 3] |= 1 << ((node-1) & 7);
+        }
+        node = 2*node + dir;
+    }
+}
+
+void TreePlruPolicy::insert(uint8_t* repl, uint64_t index, int way)
+{
+    touch(repl, index, way);
+}
+
+int TreePlruPolicy::victim(uint8_t* repl, uint64_t index)
+{
+    int node = 1, way = 0;
+    for (int half = num_leaves >> 1; half > 0; half >>= 1) {
+        int dir = (repl[(node-1) >> 3] >> ((node-1) & 7)) & 1;
+        //Subtrees made only of padding leaves are never chosen
+        if (dir && (way | half) >= num_ways) {
+            dir = 0;
+        }
+        way |= dir ? half : 0;
+        node = 2*node + dir;
+    }
+    return way;
+}
+
+// A way is ranked by the number of nodes on its path that point towards it,
+// the victim has all of them pointing towards it.
+int TreePlruPolicy::rank(uint8_t* repl, uint64_t index, int way)
+{
+    int node = 1, num = 0;
+    for (int half = num_leaves >> 1; half > 0; half >>= 1) {
+        int dir = (way & half) ? 1 : 0;
+        if (((repl[(node-1) >> 3] >> ((node-1) & 7)) & 1) == dir) {
+            num++;
+        }
+        node = 2*node + dir;
+    }
+    return num;
+}
+
+
+
+// NRU keeps one reference bit per way, the victim is the first way whose bit
+// is clear and all other bits are cleared once every way has been referenced.
+NruPolicy::NruPolicy(int num_ways_in, uint64_t num_sets_in)
+{
+    num_ways = num_ways_in;
+    num_sets = num_sets_in;
+}
+
+int NruPolicy::getSetBytes()
+{
+    return (num_ways + 7) / 8;
+}
+
+void NruPolicy::initSet(uint8_t* repl, uint64_t index)
+{
+    memset(repl, 0, getSetBytes());
+}
+
+void NruPolicy::touch(uint8_t* repl, uint64_t index, int way)
+{
+    int i;
+    repl[way >> 3] |= 1 << (way & 7);
+    for (i = 0; i < num_ways; i++) {
+        if (!((repl[i >> 3] >> (i & 7)) & 1)) {
+            return;
+        }
+    }
+    memset(repl, 0, getSetBytes());
+    repl[way >> 3] |= 1 << (way & 7);
+}
+
+void NruPolicy::insert(uint8_t* repl, uint64_t index, int way)
+{
+    touch(repl, index, way);
+}
+
+int NruPolicy::victim(uint8_t* repl, uint64_t index)
+{
+    for (int i = 0; i < num_ways; i++) {
+        if (!((repl[i >> 3] >> (i & 7)) & 1)) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+int NruPolicy::rank(uint8_t* repl, uint64_t index, int way)
+{
+    return !((repl[way >> 3] >> (way & 7)) & 1);
+}
+
+
+
+// RRIP keeps a 2-bit re-reference prediction value per way, four ways to a
+// byte. Hits predict a near re-reference, SRRIP fills predict a long one and
+// BRRIP fills a distant one except for one out of every BRRIP_EPSILON fills.
+// DRRIP dedicates a few leader sets to each of them and lets the other sets
+// follow whichever leader misses less, as counted by the PSEL counter.
+RripPolicy::RripPolicy(int repl_type, int num_ways_in, uint64_t num_sets_in)
+{
+    rrip_type = repl_type;
+    num_ways = num_ways_in;
+    num_sets = num_sets_in;
+    psel_max = (1 << PSEL_BITS) - 1;
+    psel = psel_max / 2;
+    bimodal_count = 0;
+}
+
+int RripPolicy::getSetBytes()
+{
+    return (num_ways * RRPV_BITS + 7) / 8;
+}
+
+int RripPolicy::getRrpv(uint8_t* repl, int way)
+{
+    return (repl[way >> 2] >> ((way & 3) * RRPV_BITS)) & RRPV_MAX;
+}
+
+void RripPolicy::setRrpv(uint8_t* repl, int way, int rrpv)
+{
+    int shift = (way & 3) * RRPV_BITS;
+    repl[way >> 2] = (repl[way >> 2] & ~(RRPV_MAX << shift)) | (rrpv << shift);
+}
+
+// Leader sets are spread over the cache by matching the low bits of the set
+// index against the next higher bits, or against their complement.
+int RripPolicy::getLeader(uint64_t index)
+{
+    uint64_t mask = (1 << LEADER_BITS) - 1;
+    uint64_t low = index & mask;
+    uint64_t high = (index >> LEADER_BITS) & mask;
+    if (low == high) {
+        return SRRIP_LEADER;
+    }
+    else if (low == (~high & mask)) {
+        return BRRIP_LEADER;
+    }
+    return FOLLOWER;
+}
+
+bool RripPolicy::useBimodal(uint64_t index)
+{
+    if (rrip_type == REPL_SRRIP) {
+        return false;
+    }
+    else if (rrip_type == REPL_BRRIP) {
+        return true;
+    }
+    switch (getLeader(index)) {
+        case SRRIP_LEADER:
+            return false;
+        case BRRIP_LEADER:
+            return true;
+        default:
+            return psel > psel_max / 2;
+    }
+}
+
+void RripPolicy::initSet(uint8_t* repl, uint64_t index)
+{
+    for (int i = 0; i < num_ways; i++) {
+        setRrpv(repl, i, RRPV_MAX);
+    }
+}
+
+void RripPolicy::touch(uint8_t* repl, uint64_t index, int way)
+{
+    setRrpv(repl, way, 0);
+}
+
+// Every fill follows a miss, so the leader sets train the PSEL counter here.
+// The counter and the bimodal throttle are shared by all sets and updated
+// without a lock, a lost update only shifts the heuristic slightly.
+void RripPolicy::insert(uint8_t* repl, uint64_t index, int way)
+{
+    if (rrip_type == REPL_DRRIP) {
+        int leader = getLeader(index);
+        if (leader == SRRIP_LEADER && psel < psel_max) {
+            psel++;
+        }
+        else if (leader == BRRIP_LEADER && psel > 0) {
+            psel--;
+        }
+    }
+    if (useBimodal(index) && (bimodal_count++ % BRRIP_EPSILON) != 0) {
+        setRrpv(repl, way, RRPV_MAX);
+    }
+    else {
+        setRrpv(repl, way, RRPV_LONG);
+    }
+}
+
+int RripPolicy::victim(uint8_t* repl, uint64_t index)
+{
+    int i, rrpv_max = 0;
+    for (i = 0; i < num_ways; i++) {
+        int rrpv = getRrpv(repl, i);
+        if (rrpv == RRPV_MAX) {
+            return i;
+        }
+        if (rrpv > getRrpv(repl, rrpv_max)) {
+            rrpv_max = i;
+        }
+    }
+    //Age every way by the distance of the oldest one to the maximum
+    int age = RRPV_MAX - getRrpv(repl, rrpv_max);
+    for (i = 0; i < num_ways; i++) {
+        setRrpv(repl, i, getRrpv(repl, i) + age);
+    }
+    return rrpv_max;
+}
+
+int RripPolicy::rank(uint8_t* repl, uint64_t index, int way)
+{
+    return getRrpv(repl, way);
+}
+
+void RripPolicy::save(Checkpoint* ckpt)
+{
+    ckpt->write(&psel, sizeof(psel));
+    ckpt->write(&bimodal_count, sizeof(bimodal_count));
+}
+
+void RripPolicy::restore(Checkpoint* ckpt)
+{
+    ckpt->read(&psel, sizeof(psel));
+    ckpt->read(&bimodal_count, sizeof(bimodal_count));
+}
+
+
+
+// Random replacement keeps no per-set state, victims come from a xorshift
+// generator shared by all sets of the cache.
+RandomPolicy::RandomPolicy(int num_ways_in, uint64_t num_sets_in)
+{
+    num_ways = num_ways_in;
+    num_sets = num_sets_in;
+    seed = 0x9E3779B97F4A7C15ULL;
+}
+
+int RandomPolicy::getSetBytes()
+{
+    return 0;
+}
+
+void RandomPolicy::initSet(uint8_t* repl, uint64_t index)
+{
+}
+
+void RandomPolicy::touch(uint8_t* repl, uint64_t index, int way)
+{
+}
+
+void RandomPolicy::insert(uint8_t* repl, uint64_t index, int way)
+{
+}
+
+int RandomPolicy::victim(uint8_t* repl, uint64_t index)
+{
+    uint64_t x = seed;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    seed = x;
+    return (int)(x % num_ways);
+}
+
+// Random ranks make the first of the top ranked ways a random victim
+int RandomPolicy::rank(uint8_t* repl, uint64_t index, int way)
+{
+    return victim(repl, index);
+}
+
+void RandomPolicy::save(Checkpoint* ckpt)
+{
+    ckpt->write(&seed, sizeof(seed));
+}
+
+void RandomPolicy::restore(Checkpoint* ckpt)
+{
+    ckpt->read(&seed, sizeof(seed));
+}
@@ -0,0 +1,150 @@
+//===========================================================================
+// repl_policy.h 
+//===========================================================================
+/*
+Copyright (c) 2015 Princeton University
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Princeton University nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY PRINCETON UNIVERSITY "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL PRINCETON UNIVERSITY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef  REPL_POLICY_H
+#define  REPL_POLICY_H
+
+#include <inttypes.h>
+#include "checkpoint.h"
+
+typedef enum ReplType
+{
+    REPL_LRU       = 0, //true LRU with per-way age bits
+    REPL_TREE_PLRU = 1, //binary tree pseudo-LRU
+    REPL_NRU       = 2, //not recently used
+    REPL_SRRIP     = 3, //static re-reference interval prediction
+    REPL_BRRIP     = 4, //bimodal re-reference interval prediction
+    REPL_DRRIP     = 5, //SRRIP and BRRIP selected by set dueling
+    REPL_RANDOM    = 6  //random
+} ReplType;
+
+
+// A replacement policy keeps its per-set state inside the set record of the
+// cache, so each policy only declares how many bytes it needs per set and
+// operates on the state pointer handed over by the cache.
+// Skewed caches pick their victim among ways of different sets, so each
+// policy can also rank a single way, the larger the rank the better victim.
+class ReplPolicy
+{
+    public:
+        static ReplPolicy* create(int repl_type, int num_ways_in, uint64_t num_sets_in);
+        virtual ~ReplPolicy();
+        virtual int getSetBytes() = 0;
+        virtual void initSet(uint8_t* repl, uint64_t index) = 0;
+        virtual void touch(uint8_t* repl, uint64_t index, int way) = 0;
+        virtual void insert(uint8_t* repl, uint64_t index, int way) = 0;
+        virtual int victim(uint8_t* repl, uint64_t index) = 0;
+        virtual int rank(uint8_t* repl, uint64_t index, int way) = 0;
+        virtual void save(Checkpoint* ckpt);
+        virtual void restore(Checkpoint* ckpt);
+    protected:
+        int         num_ways;
+        uint64_t    num_sets;
+};
+
+class LruPolicy : public ReplPolicy
+{
+    public:
+        LruPolicy(int num_ways_in, uint64_t num_sets_in);
+        int getSetBytes();
+        void initSet(uint8_t* repl, uint64_t index);
+        void touch(uint8_t* repl, uint64_t index, int way);
+        void insert(uint8_t* repl, uint64_t index, int way);
+        int victim(uint8_t* repl, uint64_t index);
+        int rank(uint8_t* repl, uint64_t index, int way);
+};
+
+class TreePlruPolicy : public ReplPolicy
+{
+    public:
+        TreePlruPolicy(int num_ways_in, uint64_t num_sets_in);
+        int getSetBytes();
+        void initSet(uint8_t* repl, uint64_t index);
+        void touch(uint8_t* repl, uint64_t index, int way);
+        void insert(uint8_t* repl, uint64_t index, int way);
+        int victim(uint8_t* repl, uint64_t index);
+        int rank(uint8_t* repl, uint64_t index, int way);
+    private:
+        int         num_leaves;
+};
+
+class NruPolicy : public ReplPolicy
+{
+    public:
+        NruPolicy(int num_ways_in, uint64_t num_sets_in);
+        int getSetBytes();
+        void initSet(uint8_t* repl, uint64_t index);
+        void touch(uint8_t* repl, uint64_t index, int way);
+        void insert(uint8_t* repl, uint64_t index, int way);
+        int victim(uint8_t* repl, uint64_t index);
+        int rank(uint8_t* repl, uint64_t index, int way);
+};
+
+class RripPolicy : public ReplPolicy
+{
+    public:
+        RripPolicy(int repl_type, int num_ways_in, uint64_t num_sets_in);
+        int getSetBytes();
+        void initSet(uint8_t* repl, uint64_t index);
+        void touch(uint8_t* repl, uint64_t index, int way);
+        void insert(uint8_t* repl, uint64_t index, int way);
+        int victim(uint8_t* repl, uint64_t index);
+        int rank(uint8_t* repl, uint64_t index, int way);
+        void save(Checkpoint* ckpt);
+        void restore(Checkpoint* ckpt);
+    private:
+        int getRrpv(uint8_t* repl, int way);
+        void setRrpv(uint8_t* repl, int way, int rrpv);
+        int getLeader(uint64_t index);
+        bool useBimodal(uint64_t index);
+        int         rrip_type;
+        int         psel;
+        int         psel_max;
+        uint32_t    bimodal_count;
+};
+
+class RandomPolicy : public ReplPolicy
+{
+    public:
+        RandomPolicy(int num_ways_in, uint64_t num_sets_in);
+        int getSetBytes();
+        void initSet(uint8_t* repl, uint64_t index);
+        void touch(uint8_t* repl, uint64_t index, int way);
+        void insert(uint8_t* repl, uint64_t index, int way);
+        int victim(uint8_t* repl, uint64_t index);
+        int rank(uint8_t* repl, uint64_t index, int way);
+        void save(Checkpoint* ckpt);
+        void restore(Checkpoint* ckpt);
+    private:
+        uint64_t    seed;
+};
+
+
+#endif // REPL_POLICY_H
@@ -0,0 +1,254 @@
+//===========================================================================
+// sharers.cpp encodes the sharers of directory lines. 
+//===========================================================================
+/*
+Copyright (c) 2015 Princeton University
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Princeton University nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY PRINCETON UNIVERSITY "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL PRINCETON UNIVERSITY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <cstring>
+#include <inttypes.h>
+#include <assert.h>
+
+#include "sharers.h"
+
+using namespace std;
+
+#define SLOT_BITS       16
+#define SLOTS_PER_WORD  (64 / SLOT_BITS)
+#define SLOT_MASK       0xFFFFULL
+#define MAX_NODES       65535    // bounded by the 16-bit pointers
+#define COARSE_MODE     SLOT_MASK // count slot of an overflowed coarse vector
+
+
+void Sharers::init(int protocol_type_in, int num_nodes_in, int max_num_sharers_in)
+{
+    protocol_type = protocol_type_in;
+    num_nodes = num_nodes_in;
+    max_num_sharers = max_num_sharers_in;
+    group_size = 1;
+
+    if (protocol_type == FULL_MAP) {
+        num_words = (num_nodes + 63) / 64;
+    }
+    else if (protocol_type == LIMITED_PTR || protocol_type == COARSE_VECTOR) {
+        if (num_nodes > MAX_NODES || max_num_sharers < 0 || max_num_sharers >= MAX_NODES) {
+            cerr << "Error: At most " << MAX_NODES << " sharers can be tracked with pointers!\n";
+        }
+        assert(num_nodes <= MAX_NODES);
+        assert(max_num_sharers >= 0 && max_num_sharers < MAX_NODES);
+        //One count slot followed by the pointers
+        num_words = (max_num_sharers + 1 + SLOTS_PER_WORD - 1) / SLOTS_PER_WORD;
+        if (protocol_type == COARSE_VECTOR && max_num_sharers > COARSE_MAX_PTRS) {
+            cerr << "Error: At most " << COARSE_MAX_PTRS << " pointers are supported by the coarse vector!\n";
+        }
+        assert(protocol_type != COARSE_VECTOR || max_num_sharers <= COARSE_MAX_PTRS);
+        if (protocol_type == COARSE_VECTOR) {
+            //The coarse vector needs at least one word besides the count
+            if (num_words < 2) {
+                num_words = 2;
+            }
+            group_size = (num_nodes + (num_words-1)*64 - 1) / ((num_words-1)*64);
+        }
+    }
+    else {
+        cerr << "Error: Undefined protocol type!\n";
+        assert(false);
+    }
+}
+
+int Sharers::getWords()
+{
+    return num_words;
+}
+
+int Sharers::getSlot(uint64_t* entry, int slot)
+{
+    return (int)((entry[slot / SLOTS_PER_WORD] >> ((slot % SLOTS_PER_WORD) * SLOT_BITS)) & SLOT_MASK);
+}
+
+void Sharers::setSlot(uint64_t* entry, int slot, int value)
+{
+    int shift = (slot % SLOTS_PER_WORD) * SLOT_BITS;
+    entry[slot / SLOTS_PER_WORD] = (entry[slot / SLOTS_PER_WORD] & ~(SLOT_MASK << shift))
+                                 | ((uint64_t)value << shift);
+}
+
+// This function returns the first set bit at or after bit in a bit vector,
+// -1 is returned if there is none.
+int Sharers::nextBit(uint64_t* words, int num_words_in, int bit)
+{
+    int w = bit / 64;
+    if (w >= num_words_in) {
+        return -1;
+    }
+    uint64_t bits = words[w] & (~0ULL << (bit % 64));
+    while (bits == 0) {
+        if (++w >= num_words_in) {
+            return -1;
+        }
+        bits = words[w];
+    }
+    return w * 64 + __builtin_ctzll(bits);
+}
+
+void Sharers::clear(uint64_t* entry)
+{
+    memset(entry, 0, num_words * sizeof(uint64_t));
+}
+
+void Sharers::insert(uint64_t* entry, int id)
+{
+    int i, num_ptrs;
+    assert(id >= 0 && id < num_nodes);
+    if (protocol_type == FULL_MAP) {
+        entry[id / 64] |= 1ULL << (id % 64);
+        return;
+    }
+
+    num_ptrs = getSlot(entry, 0);
+    if (num_ptrs == COARSE_MODE) {
+        entry[1 + id / group_size / 64] |= 1ULL << ((id / group_size) % 64);
+        return;
+    }
+    for (i = 1; i <= num_ptrs; i++) {
+        if (getSlot(entry, i) == id) {
+            return;
+        }
+    }
+    if (num_ptrs < max_num_sharers) {
+        //Keep the pointers sorted so that sharers are visited in order
+        for (i = num_ptrs; i >= 1 && getSlot(entry, i) > id; i--) {
+            setSlot(entry, i+1, getSlot(entry, i));
+        }
+        setSlot(entry, i+1, id);
+        setSlot(entry, 0, num_ptrs+1);
+    }
+    else if (protocol_type == COARSE_VECTOR) {
+        coarsen(entry, id);
+    }
+    //A full limited pointer entry drops the sharer, the line is broadcast
+}
+
+// This function turns a full pointer array into a coarse vector holding its
+// pointers and the new sharer. The pointers are copied to the stack first,
+// which is bounded by COARSE_MAX_PTRS, since the directory set is locked.
+void Sharers::coarsen(uint64_t* entry, int id)
+{
+    uint16_t ptrs[COARSE_MAX_PTRS];
+    int i, num_ptrs = getSlot(entry, 0);
+    for (i = 0; i < num_ptrs; i++) {
+        ptrs[i] = (uint16_t)getSlot(entry, i+1);
+    }
+    clear(entry);
+    setSlot(entry, 0, COARSE_MODE);
+    for (i = 0; i < num_ptrs; i++) {
+        insert(entry, ptrs[i]);
+    }
+    insert(entry, id);
+}
+
+// This function removes a sharer. An overflowed coarse vector keeps the group
+// marked since other caches of the group may still share the line.
+void Sharers::remove(uint64_t* entry, int id)
+{
+    int i, num_ptrs;
+    assert(id >= 0 && id < num_nodes);
+    if (protocol_type == FULL_MAP) {
+        entry[id / 64] &= ~(1ULL << (id % 64));
+        return;
+    }
+
+    num_ptrs = getSlot(entry, 0);
+    if (num_ptrs == COARSE_MODE) {
+        return;
+    }
+    for (i = 1; i <= num_ptrs; i++) {
+        if (getSlot(entry, i) == id) {
+            for (; i < num_ptrs; i++) {
+                setSlot(entry, i, getSlot(entry, i+1));
+            }
+            setSlot(entry, num_ptrs, 0);
+            setSlot(entry, 0, num_ptrs-1);
+            return;
+        }
+    }
+}
+
+// This function returns the number of sharers, which is an upper bound for
+// overflowed coarse vectors.
+int Sharers::count(uint64_t* entry)
+{
+    int i, num = 0;
+    if (protocol_type == FULL_MAP) {
+        for (i = 0; i < num_words; i++) {
+            num += __builtin_popcountll(entry[i]);
+        }
+        return num;
+    }
+    else if (getSlot(entry, 0) == COARSE_MODE) {
+        for (i = 1; i < num_words; i++) {
+            num += __builtin_popcountll(entry[i]);
+        }
+        return num * group_size;
+    }
+    return getSlot(entry, 0);
+}
+
+int Sharers::first(uint64_t* entry)
+{
+    return next(entry, -1);
+}
+
+// This function returns the smallest sharer id larger than id, -1 is returned
+// if there is none. All caches of a marked group are visited for overflowed
+// coarse vectors.
+int Sharers::next(uint64_t* entry, int id)
+{
+    int i, num_ptrs, start = id + 1;
+    if (start >= num_nodes) {
+        return -1;
+    }
+    if (protocol_type == FULL_MAP) {
+        return nextBit(entry, num_words, start);
+    }
+
+    num_ptrs = getSlot(entry, 0);
+    if (num_ptrs == COARSE_MODE) {
+        int group = nextBit(entry + 1, num_words - 1, start / group_size);
+        if (group < 0) {
+            return -1;
+        }
+        return (group == start / group_size) ? start : group * group_size;
+    }
+    for (i = 1; i <= num_ptrs; i++) {
+        int ptr = getSlot(entry, i);
+        if (ptr >= start) {
+            return ptr;
+        }
+    }
+    return -1;
+}
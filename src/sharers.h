@@ -0,0 +1,79 @@
+//===========================================================================
+// sharers.h 
+//===========================================================================
+/*
+Copyright (c) 2015 Princeton University
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Princeton University nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY PRINCETON UNIVERSITY "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL PRINCETON UNIVERSITY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef  SHARERS_H
+#define  SHARERS_H
+
+#include <inttypes.h>
+
+#define COARSE_MAX_PTRS 4096    //a longer pointer array takes more bits than a full map of all nodes
+
+typedef enum ProtocolType
+{
+    FULL_MAP = 0,
+    LIMITED_PTR = 1,
+    COARSE_VECTOR = 2
+} ProtocolType;
+
+
+// Sharers describes how the sharers of a directory line are encoded in the
+// fixed number of 64-bit words the directory cache keeps per way. An entry
+// of all zeros always means no sharers, so caches can clear entries without
+// knowing their format.
+//
+// FULL_MAP keeps one bit per last-level cache. LIMITED_PTR keeps a sorted
+// array of at most max_num_sharers 16-bit pointers after a 16-bit count, the
+// system falls back to broadcast once it is full. COARSE_VECTOR starts out as
+// the same pointer array and, once it overflows, reuses the words after the
+// count as a bit vector with one bit per group of caches.
+class Sharers
+{
+    public:
+        void init(int protocol_type_in, int num_nodes_in, int max_num_sharers_in);
+        int getWords();
+        void clear(uint64_t* entry);
+        void insert(uint64_t* entry, int id);
+        void remove(uint64_t* entry, int id);
+        int count(uint64_t* entry);
+        int first(uint64_t* entry);
+        int next(uint64_t* entry, int id);
+    private:
+        int getSlot(uint64_t* entry, int slot);
+        void setSlot(uint64_t* entry, int slot, int value);
+        int nextBit(uint64_t* words, int num_words, int bit);
+        void coarsen(uint64_t* entry, int id);
+        int         protocol_type;
+        int         num_nodes;
+        int         max_num_sharers;
+        int         num_words;
+        int         group_size;
+};
+
+#endif // SHARERS_H
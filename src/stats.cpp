@@ -0,0 +1,111 @@
+//===========================================================================
+// stats.cpp 
+//===========================================================================
+/*
+Copyright (c) 2015 Princeton University
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Princeton University nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY PRINCETON UNIVERSITY "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL PRINCETON UNIVERSITY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include "stats.h"
+
+using namespace std;
+
+__thread int stat_shard = -1;
+__thread bool stat_warmup = false;
+static int stat_next_shard = 0;
+
+
+void Stats::init(int num_counters_in)
+{
+    num_counters = num_counters_in;
+    stride = (num_counters + STAT_LINE_WORDS - 1) / STAT_LINE_WORDS * STAT_LINE_WORDS;
+    if (posix_memalign((void**)&slots, STAT_LINE_WORDS * sizeof(uint64_t),
+                       (STAT_SHARDS + 1) * stride * sizeof(uint64_t)) != 0) {
+        cerr << "Error: Failed to allocate statistics counters!\n";
+        exit(1);
+    }
+    reset();
+}
+
+// Hand out shards to threads in the order of their first update
+int Stats::getShard()
+{
+    if (stat_shard < 0) {
+        stat_shard = __sync_fetch_and_add(&stat_next_shard, 1);
+        if (stat_shard > STAT_SHARDS) {
+            stat_shard = STAT_SHARDS;
+        }
+    }
+    return stat_shard;
+}
+
+uint64_t Stats::get(int id)
+{
+    uint64_t sum = 0;
+    for (int i = 0; i <= STAT_SHARDS; i++) {
+        sum += __atomic_load_n(&slots[i * stride + id], __ATOMIC_RELAXED);
+    }
+    return sum;
+}
+
+void Stats::set(int id, uint64_t val)
+{
+    for (int i = 0; i <= STAT_SHARDS; i++) {
+        __atomic_store_n(&slots[i * stride + id], 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&slots[id], val, __ATOMIC_RELAXED);
+}
+
+void Stats::reset()
+{
+    memset(slots, 0, (STAT_SHARDS + 1) * stride * sizeof(uint64_t));
+}
+
+// Counters are saved as their totals
+void Stats::save(Checkpoint* ckpt)
+{
+    uint64_t val;
+    for (int i = 0; i < num_counters; i++) {
+        val = get(i);
+        ckpt->write(&val, sizeof(val));
+    }
+}
+
+void Stats::restore(Checkpoint* ckpt)
+{
+    uint64_t val;
+    for (int i = 0; i < num_counters; i++) {
+        ckpt->read(&val, sizeof(val));
+        set(i, val);
+    }
+}
+
+Stats::~Stats()
+{
+    free(slots);
+}
@@ -0,0 +1,94 @@
+//===========================================================================
+// stats.h 
+//===========================================================================
+/*
+Copyright (c) 2015 Princeton University
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Princeton University nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY PRINCETON UNIVERSITY "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL PRINCETON UNIVERSITY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef  STATS_H
+#define  STATS_H
+
+#include <inttypes.h>
+#include "checkpoint.h"
+
+#define STAT_SHARDS     64      //threads with a shard of their own, the others share one more
+#define STAT_LINE_WORDS 8       //counters per cache line
+
+extern __thread int stat_shard;
+extern __thread bool stat_warmup;
+
+
+// A group of statistics counters of one module. Every thread that updates the
+// counters gets a shard of its own, padded to whole cache lines, and bumps it
+// with plain loads and stores, so updates neither lock nor move cache lines
+// between cores. The shards are only summed up when a counter is read, at
+// report time or at a sample point. Threads beyond the first STAT_SHARDS share
+// a last shard, which they update with atomic adds. Nothing is counted while
+// the updating thread serves a functional warmup access.
+class Stats
+{
+    public:
+        ~Stats();
+        void init(int num_counters_in);
+        void inc(int id);
+        void add(int id, uint64_t val);
+        uint64_t get(int id);
+        void set(int id, uint64_t val);
+        void reset();
+        void save(Checkpoint* ckpt);
+        void restore(Checkpoint* ckpt);
+        static int getShard();
+    private:
+        int         num_counters;
+        int         stride;         //words of a shard
+        uint64_t*   slots;
+};
+
+inline void Stats::inc(int id)
+{
+    add(id, 1);
+}
+
+inline void Stats::add(int id, uint64_t val)
+{
+    int shard = stat_shard;
+    uint64_t* slot;
+    if (stat_warmup) {
+        return;
+    }
+    if (shard < 0) {
+        shard = getShard();
+    }
+    slot = &slots[shard * stride + id];
+    if (shard < STAT_SHARDS) {
+        __atomic_store_n(slot, __atomic_load_n(slot, __ATOMIC_RELAXED) + val, __ATOMIC_RELAXED);
+    }
+    else {
+        __atomic_fetch_add(slot, val, __ATOMIC_RELAXED);
+    }
+}
+
+#endif // STATS_H
@@ -37,6 +37,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <inttypes.h>
 #include <cmath>
 #include <assert.h>
+#include <unistd.h>
+#include <sched.h>
 
 #include "system.h"
 #include "common.h"
@@ -57,18 +59,15 @@ void System::init(XmlSys* xml_sys_in)
     shared_llc = xml_sys->shared_llc;
     num_levels = xml_sys->num_levels;
     verbose_report = xml_sys->verbose_report;
-    total_bus_contention = 0;
-    total_num_broadcast = 0;
+    stats.init(NUM_SYS_STATS);
     max_num_sharers = xml_sys->max_num_sharers;
     directory_cache = NULL;
     tlb_cache = NULL;
+    snoop_filter = NULL;
+    coherence_type = xml_sys->coherence;
 
-    hit_flag = new bool [num_cores];
-    delay = new int [num_cores];
-    for (i=0; i<num_cores; i++) {
-        hit_flag[i] = false;
-        delay[i] = 0;
-    }
+    assert(num_levels <= LEVEL_MAX);
+    eager_init = false;
     cache_level = new CacheLevel [num_levels];
     for (i=0; i<num_levels; i++) {
         cache_level[i].level = xml_sys->cache[i].level;
@@ -81,8 +80,34 @@ void System::init(XmlSys* xml_sys_in)
         cache_level[i].ins_count = 0;
         cache_level[i].miss_count = 0;
         cache_level[i].miss_rate = 0;
+        cache_level[i].ins_count_timeline = 0;
+        cache_level[i].timeline = 0;
+        cache_level[i].timeline_avg = 0;
         cache_level[i].lock_time = 0;
     }
+    sample_interval = 0;
+    sample_next = 0;
+    num_sample_counters = 0;
+    sample_base = NULL;
+    sample_count = NULL;
+    pthread_mutex_init(&sample_lock, NULL);
+
+    for (i=0; i<num_levels; i++) {
+        //With a shared LLC all levels are private and the home is the LLC
+        hit_source[i] = (i == 0) ? LAT_L1_HIT : ((i == num_levels-1 && !shared_llc) ? LAT_LLC_HIT : LAT_L2_HIT);
+    }
+    for (i=0; i<NUM_LAT_CLASSES; i++) {
+        latency[i].init();
+    }
+
+    //Hits in private L1 caches with sequence locks skip the coherence protocol
+    l1_fast = (cache_level[0].share == 1 && xml_sys->cache[0].lock_type == SEQ_LOCK);
+    prefetch_enable = false;
+    for (i=0; i<num_levels; i++) {
+        if (xml_sys->cache[i].prefetcher != PREFETCH_NONE) {
+            prefetch_enable = true;
+        }
+    }
     cache = new Cache** [num_levels];
     for (i=0; i<num_levels; i++) {
         cache[i] = new Cache* [cache_level[i].num_caches];
@@ -92,6 +117,10 @@ void System::init(XmlSys* xml_sys_in)
     }
 
     network.init(cache_level[num_levels-1].num_caches, &(xml_sys->network));
+    sharers.init(protocol_type, cache_level[num_levels-1].num_caches, max_num_sharers);
+    home_alloc.init(xml_sys->home_policy, network.getNumNodes(), xml_sys->directory_cache.block_size,
+                    page_size, xml_sys->home_cluster_width, &network);
+    initEngine();
     home_stat = new int [network.getNumNodes()];
     for (i=0; i<network.getNumNodes(); i++) {
         home_stat[i] = 0;
@@ -106,10 +135,26 @@ void System::init(XmlSys* xml_sys_in)
     if (tlb_enable && xml_sys->tlb_cache.size > 0) {
         tlb_cache = new Cache [num_cores];
         for (i = 0; i < num_cores; i++) {
-            tlb_cache[i].init(&(xml_sys->tlb_cache), TLB_CACHE, 0, page_size, 0, i);
+            tlb_cache[i].init(&(xml_sys->tlb_cache), TLB_CACHE, 0, page_size, 0, i, 0);
         }
     }
 
+    //The snoop filter is an inclusive tag directory of the last-level caches
+    //of a bus-based system, kept as a directory cache with full-map sharers
+    if (sys_type == BUS && xml_sys->snoop_filter_entries > 0) {
+        memset(&snoop_filter_xml, 0, sizeof(snoop_filter_xml));
+        snoop_filter_xml.level = num_levels-1;
+        snoop_filter_xml.share = 1;
+        snoop_filter_xml.access_time = xml_sys->snoop_filter_latency;
+        snoop_filter_xml.block_size = cache_level[num_levels-1].block_size;
+        snoop_filter_xml.num_ways = xml_sys->snoop_filter_ways;
+        snoop_filter_xml.size = xml_sys->snoop_filter_entries * snoop_filter_xml.block_size;
+        snoop_filter_xml.prefetch_degree = 1;
+        snoop_sharers.init(FULL_MAP, cache_level[num_levels-1].num_caches, 0);
+        snoop_filter = new Cache();
+        snoop_filter->init(&snoop_filter_xml, DIRECTORY_CACHE, 0, page_size, num_levels-1, 0, snoop_sharers.getWords());
+    }
+
     cache_lock = new pthread_mutex_t* [num_levels];
     for (i=0; i<num_levels; i++) {
         cache_lock[i] = new pthread_mutex_t [cache_level[i].num_caches];
@@ -123,131 +168,322 @@ void System::init(XmlSys* xml_sys_in)
         pthread_mutex_init(&directory_cache_lock[i], NULL);
     }
 
-    cache_init_done = new bool* [num_levels];
-    for (i=0; i<num_levels; i++) {
-        cache_init_done[i] = new bool [cache_level[i].num_caches];
-        for (j=0; j<cache_level[i].num_caches; j++) {
-            cache_init_done[i][j] = false;
-        }
-    }   
-
-    directory_cache_init_done = new bool [network.getNumNodes()];
-    for (i = 0; i < network.getNumNodes(); i++) {
-        directory_cache_init_done[i] = false;
-    }
-
     page_table.init(page_size, xml_sys->page_miss_delay);
     dram.init(dram_access_time);
 }
 
 // This function models an access to memory system and returns the delay.
+// This function selects the coherence engine specialized for the system type,
+// the TLB, the home node type, the sharer encoding and the coherence protocol,
+// so that the access path does not test them for every request.
+void System::initEngine()
+{
+    if (sys_type == BUS) {
+        selectEngine<BUS, false, FULL_MAP, MESI>();
+    }
+    else if (shared_llc) {
+        selectProtocol<true>();
+    }
+    else {
+        selectProtocol<false>();
+    }
+}
+
+template <bool SHARED_LLC>
+void System::selectProtocol()
+{
+    if (protocol_type == LIMITED_PTR) {
+        selectCoherence<SHARED_LLC, LIMITED_PTR>();
+    }
+    else if (protocol_type == COARSE_VECTOR) {
+        selectCoherence<SHARED_LLC, COARSE_VECTOR>();
+    }
+    else {
+        selectCoherence<SHARED_LLC, FULL_MAP>();
+    }
+}
+
+template <bool SHARED_LLC, int PROTOCOL>
+void System::selectCoherence()
+{
+    if (coherence_type == MOESI) {
+        selectEngine<DIRECTORY, SHARED_LLC, PROTOCOL, MOESI>();
+    }
+    else if (coherence_type == MESIF) {
+        selectEngine<DIRECTORY, SHARED_LLC, PROTOCOL, MESIF>();
+    }
+    else {
+        selectEngine<DIRECTORY, SHARED_LLC, PROTOCOL, MESI>();
+    }
+}
+
+template <int SYS_TYPE, bool SHARED_LLC, int PROTOCOL, int COHERENCE>
+void System::selectEngine()
+{
+    if (tlb_enable) {
+        engine = &System::accessEngine<SYS_TYPE, true, SHARED_LLC, PROTOCOL, COHERENCE>;
+    }
+    else {
+        engine = &System::accessEngine<SYS_TYPE, false, SHARED_LLC, PROTOCOL, COHERENCE>;
+    }
+    if (SYS_TYPE == DIRECTORY) {
+        coherence = &System::mesi_directory<SHARED_LLC, PROTOCOL, COHERENCE>;
+    }
+    else {
+        coherence = &System::mesi_bus;
+    }
+}
+
 int System::access(int core_id, InsMem* ins_mem, int64_t timer)
+{
+    return (this->*engine)(core_id, ins_mem, timer);
+}
+
+template <int SYS_TYPE, bool TLB, bool SHARED_LLC, int PROTOCOL, int COHERENCE>
+int System::accessEngine(int core_id, InsMem* ins_mem, int64_t timer)
 {
     int cache_id;
+    Cache* cache_cur;
+    AccessCtx ctx;
     if (core_id >= num_cores) {
         cerr << "Error: Not enough cores!\n";
         return -1;
     }
 
-    hit_flag[core_id] = false;
-    delay[core_id] = 0;
+    //Functional warmup accesses only update the uncore state, no statistics
+    //are recorded while the thread serves them
+    stat_warmup = ins_mem->warmup;
+
+    ctx.core_id = core_id;
+    ctx.hit_flag = false;
+    ctx.delay = 0;
+    ctx.overlap = 0;
+    ctx.source = NUM_LAT_CLASSES;
     cache_id = core_id / cache_level[0].share;
+    if (prefetch_enable) {
+        memset(ctx.pf_event, PF_NONE, num_levels);
+    }
  
-    if (tlb_enable) {
-        delay[core_id] = tlb_translate(ins_mem, core_id, timer);
+    if (TLB) {
+        ctx.delay = tlb_translate(ins_mem, core_id, timer);
     }
  
-    if (sys_type == DIRECTORY) {
-        mesi_directory(cache[0][core_id], 0, cache_id, core_id, ins_mem, timer + delay[core_id]);
+    //Building an L1 cache also builds all caches above it
+    cache_cur = cache[0][cache_id];
+    if (cache_cur == NULL) {
+        cache_cur = init_caches(0, cache_id);
     }
-    else {
-        mesi_bus(cache[0][core_id], 0, cache_id, core_id, ins_mem, timer + delay[core_id]);
+    if (!l1_fast || !l1Hit(cache_cur, &ctx, ins_mem, timer + ctx.delay)) {
+        if (SYS_TYPE == DIRECTORY) {
+            mesi_directory<SHARED_LLC, PROTOCOL, COHERENCE>(cache_cur, 0, cache_id, &ctx, ins_mem, timer + ctx.delay);
+        }
+        else {
+            mesi_bus(cache_cur, 0, cache_id, &ctx, ins_mem, timer + ctx.delay);
+        }
     }
 
-    return delay[core_id];
+    if (prefetch_enable) {
+        ctx.delay += prefetch(&ctx, ins_mem, timer);
+    }
+    //A non-blocking miss is recorded with the time until its data arrives
+    if (ctx.source < NUM_LAT_CLASSES) {
+        latency[(int)ctx.source].record(ctx.delay + ctx.overlap);
+    }
+    if (sample_interval > 0 && !ins_mem->warmup && timer >= sample_next) {
+        sample(timer);
+    }
+    return ctx.delay;
 }
 
 
-//Initialize caches on demand
+// This function returns the time a core waits at the end of a batch of
+// requests for the outstanding misses of its L1 cache.
+int System::drain(int core_id, int64_t timer)
+{
+    Cache* cache_cur = cache[0][core_id / cache_level[0].share];
+    if (cache_cur == NULL || cache_cur->mshr == NULL || cache_cur->mshr->getLastReady() <= timer) {
+        return 0;
+    }
+    return (int)(cache_cur->mshr->getLastReady() - timer);
+}
+
+
+//Initialize caches on demand. A cache is only published in the cache array
+//once it is linked to its parent, so the access path can test the pointer
+//without taking the lock.
 Cache* System::init_caches(int level, int cache_id)
 {
     int k;
+    Cache* cache_new;
+    Cache* parent;
     pthread_mutex_lock(&cache_lock[level][cache_id]);
     if (cache[level][cache_id] == NULL) {
-        cache[level][cache_id] = new Cache();
-        cache[level][cache_id]->init(&(xml_sys->cache[level]), DATA_CACHE, xml_sys->bus_latency, page_size, level, cache_id);
+        cache_new = new Cache();
+        cache_new->init(&(xml_sys->cache[level]), DATA_CACHE, xml_sys->bus_latency, page_size, level, cache_id, 0);
         if (level == 0) {
-            cache[level][cache_id]->num_children = 0;
-            cache[level][cache_id]->child = NULL;
+            cache_new->num_children = 0;
+            cache_new->child = NULL;
         }
         else {
-            cache[level][cache_id]->num_children = cache_level[level].share/cache_level[level-1].share;
-            cache[level][cache_id]->child = new Cache* [cache[level][cache_id]->num_children];
-            for (k=0; k<cache[level][cache_id]->num_children; k++) {
-                cache[level][cache_id]->child[k] = cache[level-1][cache_id*cache[level][cache_id]->num_children+k];
+            cache_new->num_children = cache_level[level].share/cache_level[level-1].share;
+            cache_new->child = new Cache* [cache_new->num_children];
+            for (k=0; k<cache_new->num_children; k++) {
+                cache_new->child[k] = cache[level-1][cache_id*cache_new->num_children+k];
             }
         }
 
         if (level == num_levels-1) {
-            cache[level][cache_id]->parent = NULL;
+            parent = NULL;
         }
         else {
-            init_caches(level+1, cache_id*cache_level[level].share/cache_level[level+1].share);
-            cache[level][cache_id]->parent = cache[level+1][cache_id*cache_level[level].share/cache_level[level+1].share];
+            parent = init_caches(level+1, cache_id*cache_level[level].share/cache_level[level+1].share);
         }
-    }
-    else {
-        for (k=0; k<cache[level][cache_id]->num_children; k++) {
-            cache[level][cache_id]->child[k] = cache[level-1][cache_id*cache[level][cache_id]->num_children+k];
+        cache_new->parent = parent;
+        __sync_synchronize();
+        cache[level][cache_id] = cache_new;
+        if (parent != NULL) {
+            pthread_mutex_lock(&cache_lock[level+1][cache_id*cache_level[level].share/cache_level[level+1].share]);
+            parent->child[cache_id % parent->num_children] = cache_new;
+            pthread_mutex_unlock(&cache_lock[level+1][cache_id*cache_level[level].share/cache_level[level+1].share]);
         }
     }
-    cache_init_done[level][cache_id] = true;
     pthread_mutex_unlock(&cache_lock[level][cache_id]);
     return cache[level][cache_id];
 }
 
-void System::init_directories(int home_id)
+Cache* System::init_directories(int home_id)
 {
+    Cache* cache_new;
     pthread_mutex_lock(&directory_cache_lock[home_id]);
     if (directory_cache[home_id] == NULL) {
-        directory_cache[home_id] = new Cache();
-        directory_cache[home_id]->init(&(xml_sys->directory_cache), DIRECTORY_CACHE, xml_sys->bus_latency, page_size, 0, home_id);
+        cache_new = new Cache();
+        cache_new->init(&(xml_sys->directory_cache), DIRECTORY_CACHE, xml_sys->bus_latency, page_size, 0, home_id, sharers.getWords());
+        __sync_synchronize();
+        directory_cache[home_id] = cache_new;
     }
-    directory_cache_init_done[home_id] = true;
     pthread_mutex_unlock(&directory_cache_lock[home_id]);
+    return directory_cache[home_id];
+}
+
+// Build every data and directory cache upfront with one thread per receive
+// thread of prime. Each builder runs on the CPU its receive thread is bound
+// to and builds the caches of the cores that receive thread serves, so the
+// pages of a cache are first touched, and thus placed, on the NUMA node that
+// accesses them. Levels are built top-down so that parents always exist when
+// their children are linked.
+void System::build(int num_threads)
+{
+    int t;
+    pthread_t* thread = new pthread_t [num_threads];
+    BuildArg* arg = new BuildArg [num_threads];
+    pthread_barrier_t barrier;
+    eager_init = true;
+    pthread_barrier_init(&barrier, NULL, num_threads);
+    for (t = 0; t < num_threads; t++) {
+        arg[t].sys = this;
+        arg[t].thread_id = t;
+        arg[t].num_threads = num_threads;
+        arg[t].barrier = &barrier;
+        pthread_create(&thread[t], NULL, buildThread, (void*)&arg[t]);
+    }
+    for (t = 0; t < num_threads; t++) {
+        pthread_join(thread[t], NULL);
+    }
+    pthread_barrier_destroy(&barrier);
+    delete [] arg;
+    delete [] thread;
+}
+
+void* System::buildThread(void* arg_in)
+{
+    BuildArg* arg = (BuildArg*)arg_in;
+    arg->sys->buildPart(arg->thread_id, arg->num_threads, arg->barrier);
+    return NULL;
+}
+
+// A cache belongs to the receive thread serving its first core, and a
+// directory slice to the one of the last-level cache on the same node
+void System::buildPart(int thread_id, int num_threads, pthread_barrier_t* barrier)
+{
+    int i, level;
+    bindThread(thread_id, num_threads);
+    for (level = num_levels-1; level >= 0; level--) {
+        for (i = 0; i < cache_level[level].num_caches; i++) {
+            if ((i * cache_level[level].share) % num_threads == thread_id) {
+                init_caches(level, i);
+                if (level == num_levels-1 && directory_cache != NULL) {
+                    init_directories(i);
+                }
+            }
+        }
+        pthread_barrier_wait(barrier);
+    }
+}
+
+// Bind the calling thread to a CPU, receive threads and builders with the
+// same ID share it. Threads are spread evenly over the online CPUs, which
+// keeps consecutive threads on the same socket.
+void System::bindThread(int thread_id, int num_threads)
+{
+    int num_cpus;
+    cpu_set_t cpu_set;
+    if (!eager_init) {
+        return;
+    }
+    num_cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_cpus <= 0) {
+        return;
+    }
+    CPU_ZERO(&cpu_set);
+    if (num_threads <= num_cpus) {
+        CPU_SET(thread_id * num_cpus / num_threads, &cpu_set);
+    }
+    else {
+        CPU_SET(thread_id % num_cpus, &cpu_set);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
 }
 
 
 
 // This function models an acess to a multi-level cache sytem with bus-based
 // MESI coherence protocol
-char System::mesi_bus(Cache* cache_cur, int level, int cache_id, int core_id, InsMem* ins_mem, int64_t timer)
+char System::mesi_bus(Cache* cache_cur, int level, int cache_id, AccessCtx* ctx, InsMem* ins_mem, int64_t timer)
 {
     int i, shared_line;
-    int delay_bus;
+    int delay_bus, delay_miss, stall;
     Line*  line_cur;
     Line*  line_temp;
-    InsMem ins_mem_old;
+    InsMem ins_mem_old = *ins_mem;
+    Addr*  addr;
     
-    if (!cache_init_done[level][cache_id]) {
-        cache_cur = init_caches(level, cache_id); 
-    }
-    if (cache_cur->bus != NULL) {
-        delay_bus = cache_cur->bus->access(timer+delay[core_id]);
-        total_bus_contention += delay_bus;
-        delay[core_id] += delay_bus;
+    addr = &ctx->addr[level];
+    cache_cur->addrParse(ins_mem->addr_dmem, addr);
+    if (cache_cur->bus != NULL && !ins_mem->warmup) {
+        delay_bus = cache_cur->bus->access(timer+ctx->delay);
+        stats.add(SYS_BUS_CONTENTION, delay_bus);
+        ctx->delay += delay_bus;
     }
-    delay[core_id] += cache_level[level].access_time;
-    if(!hit_flag[core_id]) {
-        cache_cur->incInsCount();
+    ctx->delay += cache_level[level].access_time;
+    if(!ctx->hit_flag) {
+        cache_cur->incInsCount(addr);
     }
 
-    cache_cur->lockUp(ins_mem);
-    line_cur = cache_cur->accessLine(ins_mem);
+    if ((ins_mem->mem_type == RD) && (cache_cur->getLockType() == SEQ_LOCK) && (level > 0 || !l1_fast)
+    &&  readHit(cache_cur, level, ctx, ins_mem, timer)) {
+        return S;
+    }
+    cache_cur->lockUp(addr);
+    line_cur = cache_cur->accessLine(ins_mem, addr);
     //Cache hit
     if (line_cur != NULL) {
-        line_cur->timestamp = timer+delay[core_id];
-        hit_flag[core_id] = true; 
+        cache_cur->touchLine(line_cur);
+        ctx->hit_flag = true; 
+        ctx->source = hit_source[level];
+        recordAccess(cache_cur, level, ctx, ins_mem, line_cur);
+        if (cache_cur->mshr != NULL && !ins_mem->warmup) {
+            ctx->delay += cache_cur->mshr->pending(ins_mem->addr_dmem, timer+ctx->delay);
+        }
         //Write
         if (ins_mem->mem_type == WR) {
            if (level != num_levels-1) {
@@ -255,16 +491,20 @@ char System::mesi_bus(Cache* cache_cur, int level, int cache_id, int core_id, In
                    line_cur->state = I;
                    line_cur->state = mesi_bus(cache_cur->parent, level+1, 
                                           cache_id*cache_level[level].share/cache_level[level+1].share, 
-                                          core_id, ins_mem, timer+delay[core_id]);
+                                          ctx, ins_mem, timer+ctx->delay);
                }
            }
            else {
-               if (line_cur->state == S) {
+               if (line_cur->state == S && snoop_filter != NULL) {
+                   ctx->delay += snoop_filter->getAccessTime();
+                   snoopFilter(cache_id, ins_mem);
+               }
+               else if (line_cur->state == S) {
                    shared_line = 0;
                    for (i=0; i < cache_level[num_levels-1].num_caches; i++) {
                        if (i != cache_id) {
-                           if (!cache_init_done[num_levels-1][i]) {
-                               init_caches(num_levels-1, i);
+                           if (cache[num_levels-1][i] == NULL) {
+                               continue;
                            }
                            line_temp = cache[num_levels-1][i]->accessLine(ins_mem);
                            if(line_temp != NULL) {
@@ -278,7 +518,7 @@ char System::mesi_bus(Cache* cache_cur, int level, int cache_id, int core_id, In
                line_cur->state = M;
            }
            inval_children(cache_cur, ins_mem);
-           cache_cur->unlockUp(ins_mem);
+           cache_cur->unlockUp(addr);
            return M;
         }
         //Read
@@ -286,7 +526,7 @@ char System::mesi_bus(Cache* cache_cur, int level, int cache_id, int core_id, In
             if (line_cur->state != S) {
                 share_children(cache_cur, ins_mem);
             }
-            cache_cur->unlockUp(ins_mem);
+            cache_cur->unlockUp(addr);
             return S;
         }
     }
@@ -294,15 +534,37 @@ char System::mesi_bus(Cache* cache_cur, int level, int cache_id, int core_id, In
     else
     {
         //Evict old line
-        line_cur = cache_cur->replaceLine(&ins_mem_old, ins_mem);
+        delay_miss = ctx->delay;
+        line_cur = cache_cur->replaceLine(&ins_mem_old, ins_mem, addr);
+        recordAccess(cache_cur, level, ctx, ins_mem, NULL);
         if (line_cur->state) {
+            if (ins_mem->prefetch && cache_cur->prefetcher != NULL) {
+                cache_cur->prefetcher->evict(ins_mem_old.addr_dmem);
+            }
             inval_children(cache_cur, &ins_mem_old);
+            if (level == num_levels-1 && snoop_filter != NULL) {
+                snoopEvict(cache_id, &ins_mem_old);
+            }
         }
-        line_cur->timestamp = timer+delay[core_id];
         if (level != num_levels-1) {
             line_cur->state = mesi_bus(cache_cur->parent, level+1, 
-                                   cache_id*cache_level[level].share/cache_level[level+1].share, core_id, 
-                                   ins_mem, timer+delay[core_id]);
+                                   cache_id*cache_level[level].share/cache_level[level+1].share, ctx, 
+                                   ins_mem, timer+ctx->delay);
+        }
+        else if (snoop_filter != NULL) {
+            ctx->delay += snoop_filter->getAccessTime();
+            shared_line = snoopFilter(cache_id, ins_mem);
+            if (ins_mem->mem_type == WR) {
+                line_cur->state = M;
+            }
+            else if (shared_line) {
+                line_cur->state = S;
+            }
+            else {
+                line_cur->state = E;
+            }
+            ctx->delay += dram.access(ins_mem);
+            ctx->source = LAT_DRAM;
         }
         else {
             //Write miss
@@ -310,8 +572,8 @@ char System::mesi_bus(Cache* cache_cur, int level, int cache_id, int core_id, In
                 shared_line = 0;
                 for (i=0; i < cache_level[num_levels-1].num_caches; i++) {
                     if (i != cache_id) {
-                        if (!cache_init_done[num_levels-1][i]) {
-                            init_caches(num_levels-1, i);
+                        if (cache[num_levels-1][i] == NULL) {
+                            continue;
                         }
                         line_temp = cache[num_levels-1][i]->accessLine(ins_mem);
                         if (line_temp != NULL) {
@@ -334,9 +596,9 @@ char System::mesi_bus(Cache* cache_cur, int level, int cache_id, int core_id, In
                  shared_line = 0;
                  for (i=0; i < cache_level[num_levels-1].num_caches; i++) {
                     if (i != cache_id) {
-                         if (!cache_init_done[num_levels-1][i]) {
-                             init_caches(num_levels-1, i);
-                         } 
+                         if (cache[num_levels-1][i] == NULL) {
+                             continue;
+                         }
                          line_temp = cache[num_levels-1][i]->accessLine(ins_mem);
                          if(line_temp != NULL)
                          {
@@ -359,125 +621,250 @@ char System::mesi_bus(Cache* cache_cur, int level, int cache_id, int core_id, In
                      line_cur->state = E;
                  }
              }
-             delay[core_id] += dram.access(ins_mem);                    
+             ctx->delay += dram.access(ins_mem);                    
+             ctx->source = LAT_DRAM;
         }  
-        cache_cur->incMissCount();        
-        cache_cur->unlockUp(ins_mem);
-        return line_cur->state; 
+        if (cache_cur->mshr != NULL && !ins_mem->warmup) {
+            stall = cache_cur->mshr->allocate(ins_mem->addr_dmem, timer+delay_miss, timer+ctx->delay);
+            if (level == 0 && !ins_mem->prefetch) {
+                //L1 misses do not block the core, which only waits for a free MSHR
+                ctx->overlap = ctx->delay - delay_miss;
+                ctx->delay = delay_miss + stall;
+            }
+            else {
+                ctx->delay += stall;
+            }
+        }
+        if (!ins_mem->prefetch) {
+            cache_cur->incMissCount();        
+        }
+        cache_cur->unlockUp(addr);
+        return (line_cur->state == F) ? S : line_cur->state; 
     }
 }
 
+// This function snoops the last-level caches recorded as holders of a line by
+// the snoop filter instead of all of them. Holders other than cache_id are
+// invalidated upon writes and downgraded to S upon reads, then cache_id is
+// recorded as a holder. Whether any other cache held the line is returned.
+int System::snoopFilter(int cache_id, InsMem* ins_mem)
+{
+    int i, shared_line = 0;
+    Line* line_temp;
+    Line* entry;
+    uint64_t* sharer_set;
+    Cache* llc;
+
+    snoop_filter->lockUp(ins_mem);
+    entry = snoopEntry(ins_mem);
+    sharer_set = snoop_filter->getSharers(entry);
+    for (i = snoop_sharers.first(sharer_set); i >= 0; i = snoop_sharers.next(sharer_set, i)) {
+        if (i == cache_id) {
+            continue;
+        }
+        stats.inc(SYS_SNOOPS);
+        llc = cache[num_levels-1][i];
+        line_temp = llc->accessLine(ins_mem);
+        if (line_temp == NULL) {
+            continue;
+        }
+        shared_line = 1;
+        if (ins_mem->mem_type == WR) {
+            inval_children(llc, ins_mem);
+            line_temp->state = I;
+        }
+        else {
+            share_children(llc, ins_mem);
+            line_temp->state = S;
+        }
+    }
+    if (ins_mem->mem_type == WR) {
+        snoop_sharers.clear(sharer_set);
+    }
+    snoop_sharers.insert(sharer_set, cache_id);
+    snoop_filter->unlockUp(ins_mem);
+    return shared_line;
+}
+
+// This function returns the snoop filter entry of a line and allocates it if
+// needed. Since the filter is inclusive, the line of an evicted entry is
+// invalidated in all last-level caches that hold it.
+Line* System::snoopEntry(InsMem* ins_mem)
+{
+    int i;
+    Line* entry;
+    Line* line_temp;
+    uint64_t* sharer_set;
+    InsMem ins_mem_old = *ins_mem;
+
+    snoop_filter->incInsCount();
+    entry = snoop_filter->accessLine(ins_mem);
+    if (entry != NULL) {
+        snoop_filter->touchLine(entry);
+        return entry;
+    }
+    snoop_filter->incMissCount();
+    entry = snoop_filter->replaceLine(&ins_mem_old, ins_mem);
+    sharer_set = snoop_filter->getSharers(entry);
+    if (entry->state) {
+        snoop_filter->incEvictCount();
+        for (i = snoop_sharers.first(sharer_set); i >= 0; i = snoop_sharers.next(sharer_set, i)) {
+            line_temp = cache[num_levels-1][i]->accessLine(&ins_mem_old);
+            if (line_temp != NULL) {
+                stats.inc(SYS_SNOOP_BACK_INVAL);
+                inval_children(cache[num_levels-1][i], &ins_mem_old);
+                line_temp->state = I;
+            }
+        }
+    }
+    snoop_sharers.clear(sharer_set);
+    entry->state = V;
+    return entry;
+}
+
+// This function removes a last-level cache from the holders of a line it
+// evicted, and frees the entry once no holder is left.
+void System::snoopEvict(int cache_id, InsMem* ins_mem)
+{
+    Line* entry;
+    uint64_t* sharer_set;
+
+    snoop_filter->lockUp(ins_mem);
+    entry = snoop_filter->accessLine(ins_mem);
+    if (entry != NULL) {
+        sharer_set = snoop_filter->getSharers(entry);
+        snoop_sharers.remove(sharer_set, cache_id);
+        if (snoop_sharers.count(sharer_set) == 0) {
+            entry->state = I;
+        }
+    }
+    snoop_filter->unlockUp(ins_mem);
+}
+
 // This function models an acess to a multi-level cache sytem with directory-
-// based MESI coherence protocol
-char System::mesi_directory(Cache* cache_cur, int level, int cache_id, int core_id, InsMem* ins_mem, int64_t timer)
+// based MESI, MOESI or MESIF coherence protocol. The O and F states are only
+// held by last-level caches, whose children keep such lines in S.
+template <bool SHARED_LLC, int PROTOCOL, int COHERENCE>
+char System::mesi_directory(Cache* cache_cur, int level, int cache_id, AccessCtx* ctx, InsMem* ins_mem, int64_t timer)
 {
-    int id_home, delay_bus;
+    int id_home, delay_bus, delay_miss, stall;
     char state_tmp;
     Line*  line_cur;
-    InsMem ins_mem_old;
+    InsMem ins_mem_old = *ins_mem;
+    Addr*  addr;
   
-    if (!cache_init_done[level][cache_id]) {
-        cache_cur = init_caches(level, cache_id); 
-    }
+    addr = &ctx->addr[level];
+    cache_cur->addrParse(ins_mem->addr_dmem, addr);
 
     assert(cache_cur != NULL);
-    if (cache_cur->bus != NULL) {
-        delay_bus = cache_cur->bus->access(timer+delay[core_id]);
-        total_bus_contention += delay_bus;
-        delay[core_id] += delay_bus;
+    if (cache_cur->bus != NULL && !ins_mem->warmup) {
+        delay_bus = cache_cur->bus->access(timer+ctx->delay);
+        stats.add(SYS_BUS_CONTENTION, delay_bus);
+        ctx->delay += delay_bus;
     }
 
-    if (!hit_flag[core_id]) {
-        cache_cur->incInsCount();
+    if (!ctx->hit_flag) {
+        cache_cur->incInsCount(addr);
     }
 
-    cache_cur->lockUp(ins_mem);
-    delay[core_id] += cache_level[level].access_time;
-    line_cur = cache_cur->accessLine(ins_mem);
+    ctx->delay += cache_level[level].access_time;
+    if ((ins_mem->mem_type == RD) && (cache_cur->getLockType() == SEQ_LOCK) && (level > 0 || !l1_fast)
+    &&  readHit(cache_cur, level, ctx, ins_mem, timer)) {
+        return S;
+    }
+    cache_cur->lockUp(addr);
+    line_cur = cache_cur->accessLine(ins_mem, addr);
     //Cache hit
     if (line_cur != NULL) {
-        line_cur->timestamp = timer + delay[core_id];
-        hit_flag[core_id] = true; 
+        cache_cur->touchLine(line_cur);
+        ctx->hit_flag = true; 
+        ctx->source = hit_source[level];
+        recordAccess(cache_cur, level, ctx, ins_mem, line_cur);
+        if (cache_cur->mshr != NULL && !ins_mem->warmup) {
+            ctx->delay += cache_cur->mshr->pending(ins_mem->addr_dmem, timer+ctx->delay);
+        }
         //Write
         if (ins_mem->mem_type == WR) {
            if (level != num_levels-1) {
                if (line_cur->state != M) {
                    line_cur->state = I;
-                   line_cur->state = mesi_directory(cache_cur->parent, level+1, 
+                   line_cur->state = mesi_directory<SHARED_LLC, PROTOCOL, COHERENCE>(cache_cur->parent, level+1, 
                                           cache_id*cache_level[level].share/cache_level[level+1].share, 
-                                          core_id, ins_mem, timer + delay[core_id]);
+                                          ctx, ins_mem, timer + ctx->delay);
                }
            }
            else {
-               if (line_cur->state == S) {
-                   id_home = getHomeId(ins_mem);
-                   delay[core_id] += network.transmit(cache_id, id_home, 0, timer+delay[core_id]);
-                   if (shared_llc) {
-                       delay[core_id] += accessSharedCache(cache_id, id_home, ins_mem, timer+delay[core_id], &state_tmp);
-                    
-                   }    
-                   else {
-                       delay[core_id] += accessDirectoryCache(cache_id, id_home, ins_mem, timer+delay[core_id], &state_tmp);
-                   }
-                   delay[core_id] += network.transmit(id_home, cache_id, 0, timer+delay[core_id]);
+               if (line_cur->state == S || line_cur->state == O || line_cur->state == F) {
+                   id_home = getHomeId(ins_mem, cache_id);
+                   ctx->delay += transmit(ins_mem, cache_id, id_home, 0, timer+ctx->delay);
+                   ctx->delay += accessHome<SHARED_LLC, PROTOCOL, COHERENCE>(cache_id, id_home, ctx, ins_mem, timer+ctx->delay, &state_tmp);
+                   ctx->delay += transmit(ins_mem, id_home, cache_id, 0, timer+ctx->delay);
 
                }
                line_cur->state = M;
            }
-           cache_cur->unlockUp(ins_mem);
+           cache_cur->unlockUp(addr);
            return M;
         }
         //Read
         else {
-            if (line_cur->state != S) {
-                delay[core_id] += share_children(cache_cur, ins_mem);
+            if (line_cur->state != S && line_cur->state != O && line_cur->state != F) {
+                ctx->delay += share_children(cache_cur, ins_mem);
             }
-            cache_cur->unlockUp(ins_mem);
+            cache_cur->unlockUp(addr);
             return S;
         }
     }
     //Cache miss
     else {
-        line_cur = cache_cur->replaceLine(&ins_mem_old, ins_mem);
+        delay_miss = ctx->delay;
+        line_cur = cache_cur->replaceLine(&ins_mem_old, ins_mem, addr);
+        recordAccess(cache_cur, level, ctx, ins_mem, NULL);
         if (line_cur->state) {
+            if (ins_mem->prefetch && cache_cur->prefetcher != NULL) {
+                cache_cur->prefetcher->evict(ins_mem_old.addr_dmem);
+            }
             cache_cur->incEvictCount();
-            delay[core_id] += inval_children(cache_cur, &ins_mem_old);
-            if(line_cur->state == M || line_cur->state == E) {
+            ctx->delay += inval_children(cache_cur, &ins_mem_old);
+            if(line_cur->state == M || line_cur->state == E || line_cur->state == O) {
                 cache_cur->incWbCount();
                 if (level == num_levels-1) {
-                    id_home = getHomeId(&ins_mem_old);
+                    id_home = getHomeId(&ins_mem_old, cache_id);
                     ins_mem_old.mem_type = WB; 
-                    network.transmit(cache_id, id_home, cache_level[num_levels-1].block_size,  timer+delay[core_id]);
-                    if (shared_llc) {
-                        accessSharedCache(cache_id, id_home, &ins_mem_old, timer+delay[core_id], &state_tmp);
-                    }
-                    else {
-                        accessDirectoryCache(cache_id, id_home, &ins_mem_old, timer+delay[core_id], &state_tmp);
-                    }
+                    transmit(ins_mem, cache_id, id_home, cache_level[num_levels-1].block_size,  timer+ctx->delay);
+                    accessHome<SHARED_LLC, PROTOCOL, COHERENCE>(cache_id, id_home, ctx, &ins_mem_old, timer+ctx->delay, &state_tmp);
                 }
             }
         }
-        line_cur->timestamp = timer + delay[core_id];
         if (level != num_levels-1) {
-            line_cur->state = mesi_directory(cache_cur->parent, level+1, 
-                                   cache_id*cache_level[level].share/cache_level[level+1].share, core_id, 
+            line_cur->state = mesi_directory<SHARED_LLC, PROTOCOL, COHERENCE>(cache_cur->parent, level+1, 
+                                   cache_id*cache_level[level].share/cache_level[level+1].share, ctx, 
                                    ins_mem, timer);
         }
         else {
-            id_home = getHomeId(ins_mem);
-            delay[core_id] += network.transmit(cache_id, id_home, 0,  timer+delay[core_id]);
-            if (shared_llc) {
-                delay[core_id] += accessSharedCache(cache_id, id_home, ins_mem, timer+delay[core_id], &state_tmp);
+            id_home = getHomeId(ins_mem, cache_id);
+            ctx->delay += transmit(ins_mem, cache_id, id_home, 0,  timer+ctx->delay);
+            ctx->delay += accessHome<SHARED_LLC, PROTOCOL, COHERENCE>(cache_id, id_home, ctx, ins_mem, timer+ctx->delay, &state_tmp);
+            line_cur->state = state_tmp;
+            ctx->delay += transmit(ins_mem, id_home, cache_id, cache_level[num_levels-1].block_size, timer+ctx->delay);
+        }  
+        if (cache_cur->mshr != NULL && !ins_mem->warmup) {
+            stall = cache_cur->mshr->allocate(ins_mem->addr_dmem, timer+delay_miss, timer+ctx->delay);
+            if (level == 0 && !ins_mem->prefetch) {
+                //L1 misses do not block the core, which only waits for a free MSHR
+                ctx->overlap = ctx->delay - delay_miss;
+                ctx->delay = delay_miss + stall;
             }
             else {
-                delay[core_id] += accessDirectoryCache(cache_id, id_home, ins_mem, timer+delay[core_id], &state_tmp);
+                ctx->delay += stall;
             }
-            line_cur->state = state_tmp;
-            delay[core_id] += network.transmit(id_home, cache_id, cache_level[num_levels-1].block_size, timer+delay[core_id]);
-        }  
-        cache_cur->incMissCount();        
-        cache_cur->unlockUp(ins_mem);
-        return line_cur->state; 
+        }
+        if (!ins_mem->prefetch) {
+            cache_cur->incMissCount();        
+        }
+        cache_cur->unlockUp(addr);
+        //An F line of the LLC is held in S by its children
+        return (line_cur->state == F) ? S : line_cur->state; 
     }
 }
 
@@ -509,6 +896,218 @@ int System::share(Cache* cache_cur, InsMem* ins_mem)
     return delay;
 }
 
+// This function downgrades the copy of a line in an owner last-level cache
+// upon a forwarded read. A modified copy becomes owned if keep_owned is set
+// and shared otherwise, whether it was modified is returned in dirty.
+int System::shareOwner(Cache* cache_cur, InsMem* ins_mem, bool keep_owned, bool* dirty)
+{
+    int delay = 0;
+    Line*  line_cur;
+
+    *dirty = false;
+    if (cache_cur != NULL) {
+        cache_cur->lockDown(ins_mem);
+        line_cur = cache_cur->accessLine(ins_mem);
+        delay += cache_cur->getAccessTime();
+        if (line_cur != NULL && (line_cur->state == M || line_cur->state == E || line_cur->state == F)) {
+            *dirty = (line_cur->state == M);
+            line_cur->state = (*dirty && keep_owned) ? O : S;
+            delay += share_children(cache_cur, ins_mem);
+        }
+        cache_cur->unlockDown(ins_mem);
+    }
+    return delay;
+}
+
+// This function returns the sharer whose last-level cache holds a line in the
+// given state, which is the O or F cache that supplies the data of the line,
+// or -1 if there is none, e.g. since an F copy was silently evicted.
+int System::findSupplier(uint64_t* sharer_set, InsMem* ins_mem, char state)
+{
+    int pos;
+    bool found;
+    Cache* cache_cur;
+    Line*  line_cur;
+
+    for (pos = sharers.first(sharer_set); pos >= 0; pos = sharers.next(sharer_set, pos)) {
+        cache_cur = cache[num_levels-1][pos];
+        if (cache_cur == NULL) {
+            continue;
+        }
+        cache_cur->lockDown(ins_mem);
+        line_cur = cache_cur->accessLine(ins_mem);
+        found = (line_cur != NULL && line_cur->state == state);
+        cache_cur->unlockDown(ins_mem);
+        if (found) {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+// This function serves a read hit from an optimistic lookup without taking
+// the set lock. It fails if the set was locked during the lookup, if the hit
+// would have to downgrade the children of the cache, or if it is the first
+// hit to a prefetched line.
+bool System::readHit(Cache* cache_cur, int level, AccessCtx* ctx, InsMem* ins_mem, int64_t timer)
+{
+    uint32_t seq;
+    char state_cur;
+    Line* line_cur;
+
+    seq = cache_cur->readBegin(&ctx->addr[level]);
+    line_cur = cache_cur->accessLine(ins_mem, &ctx->addr[level]);
+    if (line_cur == NULL) {
+        return false;
+    }
+    state_cur = line_cur->state;
+    if ((state_cur != S && state_cur != O && state_cur != F && cache_cur->num_children > 0) || line_cur->prefetched
+    ||  !cache_cur->readValidate(&ctx->addr[level], seq)) {
+        return false;
+    }
+    //The replacement state is only a hint, so it is updated without the lock
+    cache_cur->touchLine(line_cur);
+    ctx->hit_flag = true;
+    ctx->source = hit_source[level];
+    recordAccess(cache_cur, level, ctx, ins_mem, line_cur);
+    if (cache_cur->mshr != NULL && !ins_mem->warmup) {
+        ctx->delay += cache_cur->mshr->pending(ins_mem->addr_dmem, timer+ctx->delay);
+    }
+    return true;
+}
+
+// This function serves a hit in a private L1 cache before entering the
+// coherence protocol. A private L1 has no children and is only written by the
+// requests of its core and by invalidations from its parent, which lock the
+// set and bump its sequence counter. A read hit in any state and a write hit
+// to an M line change no coherence state, so they are validated against the
+// sequence counter instead of taking the lock. The access is only counted once
+// it succeeds, otherwise mesi_directory or mesi_bus serve it from the start.
+bool System::l1Hit(Cache* cache_cur, AccessCtx* ctx, InsMem* ins_mem, int64_t timer)
+{
+    uint32_t seq;
+    int delay_bus;
+    Line* line_cur;
+    Addr* addr = &ctx->addr[0];
+
+    cache_cur->addrParse(ins_mem->addr_dmem, addr);
+    seq = cache_cur->readBegin(addr);
+    line_cur = cache_cur->accessLine(ins_mem, addr);
+    if (line_cur == NULL) {
+        return false;
+    }
+    if ((ins_mem->mem_type == WR && line_cur->state != M) || line_cur->prefetched
+    ||  !cache_cur->readValidate(addr, seq)) {
+        return false;
+    }
+    if (cache_cur->bus != NULL && !ins_mem->warmup) {
+        delay_bus = cache_cur->bus->access(timer+ctx->delay);
+        stats.add(SYS_BUS_CONTENTION, delay_bus);
+        ctx->delay += delay_bus;
+    }
+    cache_cur->incInsCount(addr);
+    ctx->delay += cache_level[0].access_time;
+    cache_cur->touchLine(line_cur);
+    ctx->hit_flag = true;
+    ctx->source = LAT_L1_HIT;
+    recordAccess(cache_cur, 0, ctx, ins_mem, line_cur);
+    if (cache_cur->mshr != NULL && !ins_mem->warmup) {
+        ctx->delay += cache_cur->mshr->pending(ins_mem->addr_dmem, timer+ctx->delay);
+    }
+    return true;
+}
+
+// This function records the outcome of a demand access to a cache with a
+// prefetcher, a NULL line means a miss. The first hit to a prefetched line
+// clears its prefetched bit.
+void System::recordAccess(Cache* cache_cur, int level, AccessCtx* ctx, InsMem* ins_mem, Line* line_cur)
+{
+    if (cache_cur->prefetcher == NULL || ins_mem->prefetch) {
+        return;
+    }
+    if (line_cur == NULL) {
+        ctx->pf_event[level] = PF_MISS;
+    }
+    else if (line_cur->prefetched) {
+        line_cur->prefetched = 0;
+        ctx->pf_event[level] = PF_HIT_PREFETCHED;
+    }
+    else {
+        ctx->pf_event[level] = PF_HIT;
+    }
+}
+
+// This function trains the prefetchers with the outcome of a demand access
+// and issues their prefetches within the page of the demand. It returns the
+// time the demand waits for a prefetched line that has not arrived yet.
+int System::prefetch(AccessCtx* ctx, InsMem* ins_mem, int64_t timer)
+{
+    int level, cache_id, i, num_pf, wait, wait_max = 0;
+    uint64_t pf_addr[PREFETCH_MAX_DEGREE];
+    Cache* cache_cur;
+    Prefetcher* prefetcher;
+
+    for (level = 0; level < num_levels; level++) {
+        if (ctx->pf_event[level] == PF_NONE) {
+            continue;
+        }
+        cache_id = ctx->core_id / cache_level[level].share;
+        cache_cur = cache[level][cache_id];
+        prefetcher = cache_cur->prefetcher;
+        if (ctx->pf_event[level] == PF_HIT_PREFETCHED) {
+            wait = prefetcher->useful(ins_mem->addr_dmem, timer);
+            //Caches with MSHRs already waited for the prefetch upon the hit
+            if (cache_cur->mshr == NULL && wait > wait_max) {
+                wait_max = wait;
+            }
+        }
+        else if (ctx->pf_event[level] == PF_MISS) {
+            prefetcher->demandMiss(ins_mem->addr_dmem);
+        }
+        num_pf = prefetcher->train(ins_mem->addr_dmem, ins_mem->addr_ins, ctx->pf_event[level], pf_addr);
+        for (i = 0; i < num_pf; i++) {
+            if (pf_addr[i] / page_size == ins_mem->addr_dmem / page_size) {
+                issuePrefetch(cache_cur, level, cache_id, ctx->core_id, ins_mem, pf_addr[i], timer);
+            }
+        }
+    }
+    return wait_max;
+}
+
+// This function issues a prefetch read through the coherence protocol. The
+// prefetch neither delays the core nor counts as a demand access, and it is
+// dropped if the line is already cached.
+void System::issuePrefetch(Cache* cache_cur, int level, int cache_id, int core_id, InsMem* ins_mem, uint64_t addr, int64_t timer)
+{
+    AccessCtx ctx;
+    InsMem pf_mem = *ins_mem;
+    Line* line_cur;
+
+    pf_mem.mem_type = RD;
+    pf_mem.addr_dmem = addr;
+    pf_mem.prefetch = true;
+    cache_cur->lockUp(&pf_mem);
+    line_cur = cache_cur->accessLine(&pf_mem);
+    cache_cur->unlockUp(&pf_mem);
+    if (line_cur != NULL) {
+        return;
+    }
+
+    ctx.core_id = core_id;
+    ctx.hit_flag = true;
+    ctx.delay = 0;
+    ctx.overlap = 0;
+    ctx.source = NUM_LAT_CLASSES;
+    (this->*coherence)(cache_cur, level, cache_id, &ctx, &pf_mem, timer);
+    cache_cur->lockUp(&pf_mem);
+    line_cur = cache_cur->accessLine(&pf_mem);
+    if (line_cur != NULL) {
+        line_cur->prefetched = 1;
+    }
+    cache_cur->unlockUp(&pf_mem);
+    cache_cur->prefetcher->issue(addr, timer + ctx.delay);
+}
+
 // This function propagates down shared state starting from childern nodes
 
 int System::share_children(Cache* cache_cur, InsMem* ins_mem)
@@ -573,64 +1172,89 @@ int System::inval_children(Cache* cache_cur, InsMem* ins_mem)
 
 
 
-//Access inclusive directory cache without backup directory
-int System::accessDirectoryCache(int cache_id, int home_id, InsMem* ins_mem, int64_t timer, char* state)
+// This function accesses the home node of a line, which is either a directory
+// cache without data or, with SHARED_LLC, a slice of the distributed shared
+// LLC with embedded directories. Lines written back to a shared LLC stay valid
+// (V) in it, while data that only lives in memory is read from the DRAM.
+// Under MOESI a dirty owner keeps its data in the O state upon a read, and
+// under MESIF the last cache reading a clean line holds it in the F state,
+// in both cases that cache rather than the DRAM supplies later readers.
+template <bool SHARED_LLC, int PROTOCOL, int COHERENCE>
+int System::accessHome(int cache_id, int home_id, AccessCtx* ctx, InsMem* ins_mem, int64_t timer, char* state)
 {
-
-    if (!directory_cache_init_done[home_id]) {
-        init_directories(home_id); 
-    }
     int delay = 0, delay_temp =0, delay_pipe =0, delay_max = 0;
-    InsMem ins_mem_old;
-    IntSet::iterator pos;
+    InsMem ins_mem_old = *ins_mem;
+    int pos, supplier;
+    bool dirty;
+    uint64_t* sharer_set;
     Line* line_cur;
+    Cache* home = directory_cache[home_id];
+    if (home == NULL) {
+        home = init_directories(home_id);
+    }
+    //The F state is only kept without a shared LLC, which has the data itself
+    const bool FORWARD = (COHERENCE == MESIF && !SHARED_LLC);
+    //Limited pointers keep an O line when they overflow, the sharers dropped
+    //from a full entry are then reached by a broadcast
+    const bool OWNED_PTR = (COHERENCE == MOESI && PROTOCOL == LIMITED_PTR);
     home_stat[home_id] = 1;
-    assert(directory_cache[home_id] != NULL);
-    directory_cache[home_id]->lockUp(ins_mem);
-    line_cur = directory_cache[home_id]->accessLine(ins_mem);
-    directory_cache[home_id]->incInsCount();
-    delay += directory_cache[home_id]->getAccessTime();
-    //Directory cache miss
+    assert(home != NULL);
+    //A demand served by the home without forwarding or memory is an LLC hit
+    if (SHARED_LLC && ins_mem->mem_type != WB) {
+        ctx->source = LAT_LLC_HIT;
+    }
+    home->lockUp(ins_mem);
+    line_cur = home->accessLine(ins_mem);
+    home->incInsCount(ins_mem);
+    delay += home->getAccessTime();
+    //Home miss
     if ((line_cur == NULL) && (ins_mem->mem_type != WB)) {
-        line_cur = directory_cache[home_id]->replaceLine(&ins_mem_old, ins_mem);
+        line_cur = home->replaceLine(&ins_mem_old, ins_mem);
+        sharer_set = home->getSharers(line_cur);
         if (line_cur->state) {
-            directory_cache[home_id]->incEvictCount();
+            home->incEvictCount();
             if (line_cur->state == M || line_cur->state == E) {
-                delay += network.transmit(home_id, *line_cur->sharer_set.begin(), 0, timer+delay);
-                delay += inval(cache[num_levels-1][(*line_cur->sharer_set.begin())], &ins_mem_old);
-                delay += network.transmit(*line_cur->sharer_set.begin(), home_id, cache_level[num_levels-1].block_size, timer+delay);
+                //A clean owner of a shared LLC line only acknowledges
+                pos = sharers.first(sharer_set);
+                delay += transmit(ins_mem, home_id, pos, 0, timer+delay);
+                delay += inval(cache[num_levels-1][pos], &ins_mem_old);
+                delay += transmit(ins_mem, pos, home_id, (SHARED_LLC && line_cur->state == E) ? 0 : cache_level[num_levels-1].block_size, timer+delay);
                 dram.access(&ins_mem_old);
             }
-            else if (line_cur->state == S) {
+            else if (line_cur->state == S || (COHERENCE == MOESI && line_cur->state == O)
+                 ||  (FORWARD && line_cur->state == F)) {
                 delay_pipe = 0;
                 delay_max = 0;
-                for (pos = line_cur->sharer_set.begin(); pos != line_cur->sharer_set.end(); ++pos){
-                    delay_temp = delay_pipe; 
-                    delay_temp += network.transmit(home_id, (*pos), 0, timer+delay+delay_temp);
-                    delay_temp += inval(cache[num_levels-1][(*pos)], &ins_mem_old);
-                    delay_temp += network.transmit((*pos), home_id, 0, timer+delay+delay_temp);
+                if (OWNED_PTR && line_cur->state == O && sharers.count(sharer_set) >= max_num_sharers) {
+                    stats.inc(SYS_BROADCAST);
+                    delay_max = broadcastInval(ins_mem, &ins_mem_old, home_id, timer+delay);
+                }
+                else {
+                    for (pos = sharers.first(sharer_set); pos >= 0; pos = sharers.next(sharer_set, pos)) {
+                        delay_temp = delay_pipe; 
+                        delay_temp += transmit(ins_mem, home_id, pos, 0, timer+delay+delay_temp);
+                        delay_temp += inval(cache[num_levels-1][pos], &ins_mem_old);
+                        delay_temp += transmit(ins_mem, pos, home_id, 0, timer+delay+delay_temp);
                               
-                    if (delay_temp > delay_max) {
-                        delay_max = delay_temp;
+                        if (delay_temp > delay_max) {
+                            delay_max = delay_temp;
+                        }
+                        delay_pipe += network.getHeaderFlits();
                     }
-                    delay_pipe += network.getHeaderFlits();
                 }
+                latency[LAT_INVAL].record(delay_max);
                 delay += delay_max;
+                //The owner writes the dirty data back
+                if (COHERENCE == MOESI && line_cur->state == O) {
+                    dram.access(&ins_mem_old);
+                }
             }   
             //Broadcast
-            else if (line_cur->state == B) {
-                total_num_broadcast++;
-                for (int i = 0; i < num_cores; i++) { 
-                    delay_temp = delay_pipe;
-                    delay_temp += network.transmit(home_id, i, 0, timer+delay+delay_temp);
-                    delay_temp += inval(cache[num_levels-1][i], &ins_mem_old);
-                    delay_temp += network.transmit(i, home_id, 0, timer+delay+delay_temp);
-                    if (delay_temp > delay_max) {
-                        delay_max = delay_temp;
-                    }
-                    delay_pipe += network.getHeaderFlits();
-                }
-                delay += delay_max;
+            else if (PROTOCOL == LIMITED_PTR && line_cur->state == B) {
+                stats.inc(SYS_BROADCAST);
+                delay_temp = broadcastInval(ins_mem, &ins_mem_old, home_id, timer+delay);
+                latency[LAT_INVAL].record(delay_temp);
+                delay += delay_temp;
             } 
 
         }
@@ -641,264 +1265,224 @@ int System::accessDirectoryCache(int cache_id, int home_id, InsMem* ins_mem, int
             line_cur->state = E;
         }
 
-        directory_cache[home_id]->incMissCount();
-        line_cur->sharer_set.clear();
-        line_cur->sharer_set.insert(cache_id);
+        home->incMissCount();
+        sharers.clear(sharer_set);
+        sharers.insert(sharer_set, cache_id);
         delay += dram.access(ins_mem);
+        ctx->source = LAT_DRAM;
     }  
-    //Directoy cache hit 
+    //Home hit 
     else {
+        sharer_set = home->getSharers(line_cur);
+        home->touchLine(line_cur);
         if (ins_mem->mem_type == WR) {
             if (line_cur->state == M || line_cur->state == E) {
-                delay += network.transmit(home_id, *line_cur->sharer_set.begin(), 0, timer+delay);
-                delay += inval(cache[num_levels-1][(*line_cur->sharer_set.begin())], ins_mem);
-                delay += network.transmit(*line_cur->sharer_set.begin(), home_id, cache_level[num_levels-1].block_size, timer+delay);
+                pos = sharers.first(sharer_set);
+                delay += transmit(ins_mem, home_id, pos, 0, timer+delay);
+                delay += inval(cache[num_levels-1][pos], ins_mem);
+                delay += transmit(ins_mem, pos, home_id, cache_level[num_levels-1].block_size, timer+delay);
             }
-            else if (line_cur->state == S) {
+            else if (line_cur->state == S || (COHERENCE == MOESI && line_cur->state == O)
+                 ||  (FORWARD && line_cur->state == F)) {
+                //An O or F cache supplies the data along with its acknowledgement
+                supplier = -1;
+                if (line_cur->state != S) {
+                    supplier = findSupplier(sharer_set, ins_mem, line_cur->state);
+                }
                 delay_pipe = 0;
                 delay_max = 0;
-                for (pos = line_cur->sharer_set.begin(); pos != line_cur->sharer_set.end(); ++pos){
-                    delay_temp = delay_pipe; 
-                    delay_temp += network.transmit(home_id, (*pos), 0, timer+delay+delay_temp);
-                    delay_temp += inval(cache[num_levels-1][(*pos)], ins_mem);
-                    delay_temp += network.transmit((*pos), home_id, 0, timer+delay+delay_temp);
+                if (OWNED_PTR && line_cur->state == O && sharers.count(sharer_set) >= max_num_sharers) {
+                    stats.inc(SYS_BROADCAST);
+                    delay_max = broadcastInval(ins_mem, ins_mem, home_id, timer+delay);
+                }
+                else {
+                    for (pos = sharers.first(sharer_set); pos >= 0; pos = sharers.next(sharer_set, pos)) {
+                        delay_temp = delay_pipe; 
+                        delay_temp += transmit(ins_mem, home_id, pos, 0, timer+delay+delay_temp);
+                        delay_temp += inval(cache[num_levels-1][pos], ins_mem);
+                        delay_temp += transmit(ins_mem, pos, home_id, 0, timer+delay+delay_temp);
                               
-                    if (delay_temp > delay_max) {
-                        delay_max = delay_temp;
+                        if (delay_temp > delay_max) {
+                            delay_max = delay_temp;
+                        }
+                        delay_pipe += network.getHeaderFlits();
                     }
-                    delay_pipe += network.getHeaderFlits();
                 }
+                latency[LAT_INVAL].record(delay_max);
                 delay += delay_max;
-                delay += dram.access(ins_mem);
-            }
-            else if (line_cur->state == B) {
-                total_num_broadcast++;
-                for (int i = 0; i < num_cores; i++) { 
-                    delay_temp = delay_pipe;
-                    delay_temp += network.transmit(home_id, i, 0, timer+delay+delay_temp);
-                    delay_temp += inval(cache[num_levels-1][i], ins_mem);
-                    delay_temp += network.transmit(i, home_id, 0, timer+delay+delay_temp);
-                    if (delay_temp > delay_max) {
-                        delay_max = delay_temp;
+                //An O or F cache upgrading its own copy already has the data
+                if (supplier >= 0 && supplier != cache_id) {
+                    stats.inc(SYS_FORWARDED);
+                    ctx->source = LAT_FORWARDED;
+                    if (!SHARED_LLC) {
+                        stats.inc(SYS_DRAM_SAVED);
                     }
-                    delay_pipe += network.getHeaderFlits();
                 }
-                delay += delay_max;
-                delay += dram.access(ins_mem);
+                else if (supplier < 0 && !SHARED_LLC) {
+                    delay += dram.access(ins_mem);
+                    ctx->source = LAT_DRAM;
+                }
+            }
+            else if (PROTOCOL == LIMITED_PTR && line_cur->state == B) {
+                stats.inc(SYS_BROADCAST);
+                delay_temp = broadcastInval(ins_mem, ins_mem, home_id, timer+delay);
+                latency[LAT_INVAL].record(delay_temp);
+                delay += delay_temp;
+                if (!SHARED_LLC) {
+                    delay += dram.access(ins_mem);
+                    ctx->source = LAT_DRAM;
+                }
             } 
             line_cur->state = M;
-            line_cur->sharer_set.clear();
-            line_cur->sharer_set.insert(cache_id);
+            sharers.clear(sharer_set);
+            sharers.insert(sharer_set, cache_id);
         }
         else if (ins_mem->mem_type == RD) {
-             if (line_cur->state == M || line_cur->state == E) {
-                delay += network.transmit(home_id, *line_cur->sharer_set.begin(), 0, timer+delay);
-                delay += share(cache[num_levels-1][(*line_cur->sharer_set.begin())], ins_mem);
-                delay += network.transmit(*line_cur->sharer_set.begin(), home_id, cache_level[num_levels-1].block_size, timer+delay);
+            if (line_cur->state == M || line_cur->state == E) {
+                pos = sharers.first(sharer_set);
+                delay += transmit(ins_mem, home_id, pos, 0, timer+delay);
+                delay += shareOwner(cache[num_levels-1][pos], ins_mem, COHERENCE == MOESI, &dirty);
+                delay += transmit(ins_mem, pos, home_id, cache_level[num_levels-1].block_size, timer+delay);
                 line_cur->state = S;
-            }
-            else if (line_cur->state == S) {
-                delay += dram.access(ins_mem);
-                if ((protocol_type == LIMITED_PTR) && ((int)line_cur->sharer_set.size() >= max_num_sharers)) {
-                    line_cur->state = B;
+                //Without a shared LLC the dirty data goes to memory, unless
+                //the owner keeps it
+                if (dirty && COHERENCE == MOESI) {
+                    line_cur->state = O;
+                    stats.inc(SYS_OWNED);
+                    if (!SHARED_LLC) {
+                        stats.inc(SYS_DRAM_SAVED);
+                    }
                 }
-                else {
-                    line_cur->state = S;
+                else if (dirty && !SHARED_LLC) {
+                    dram.access(&ins_mem_old);
                 }
-
-            } 
-            else if (line_cur->state == B) {
-                delay += dram.access(ins_mem);
-                line_cur->state = B;
-            } 
-            line_cur->sharer_set.insert(cache_id);
-        } 
-        else {
-            line_cur->state = I;
-            line_cur->sharer_set.clear();
-            dram.access(ins_mem);
-        }
-    }
-    if(line_cur->state == B) {
-        (*state) = S;
-    }
-    else {
-        (*state) = line_cur->state;
-    }
-    line_cur->timestamp = timer;
-    directory_cache[home_id]->unlockUp(ins_mem);
-    return delay;
-}
-
-//Access distributed shared LLC with embedded directory cache
-int System::accessSharedCache(int cache_id, int home_id, InsMem* ins_mem, int64_t timer, char* state)
-{
-    if (!directory_cache_init_done[home_id]) {
-        init_directories(home_id); 
-    }
-    int delay = 0, delay_temp =0, delay_pipe =0, delay_max = 0;
-    InsMem ins_mem_old;
-    IntSet::iterator pos;
-    Line* line_cur;
-    home_stat[home_id] = 1;
-    directory_cache[home_id]->lockUp(ins_mem);
-    line_cur = directory_cache[home_id]->accessLine(ins_mem);
-    directory_cache[home_id]->incInsCount();
-    delay += directory_cache[home_id]->getAccessTime();
-    //Shard llc miss
-    if ((line_cur == NULL) && (ins_mem->mem_type != WB)) {
-        line_cur = directory_cache[home_id]->replaceLine(&ins_mem_old, ins_mem);
-        if (line_cur->state) {
-            directory_cache[home_id]->incEvictCount();
-            if (line_cur->state == M) {
-                delay += network.transmit(home_id, *line_cur->sharer_set.begin(), 0, timer+delay);
-                delay += inval(cache[num_levels-1][(*line_cur->sharer_set.begin())], &ins_mem_old);
-                delay += network.transmit(*line_cur->sharer_set.begin(), home_id, cache_level[num_levels-1].block_size, timer+delay);
-                dram.access(&ins_mem_old);
-            }
-            else if (line_cur->state == E) {
-                delay += network.transmit(home_id, *line_cur->sharer_set.begin(), 0, timer+delay);
-                delay += inval(cache[num_levels-1][(*line_cur->sharer_set.begin())], &ins_mem_old);
-                delay += network.transmit(*line_cur->sharer_set.begin(), home_id , 0, timer+delay);
-                dram.access(&ins_mem_old);
-            }
-            else if (line_cur->state == S) {
-                delay_pipe = 0;
-                delay_max = 0;
-                for (pos = line_cur->sharer_set.begin(); pos != line_cur->sharer_set.end(); ++pos){
-                    delay_temp = delay_pipe; 
-                    delay_temp += network.transmit(home_id, (*pos), 0, timer+delay+delay_temp);
-                    delay_temp += inval(cache[num_levels-1][(*pos)], &ins_mem_old);
-                    delay_temp += network.transmit((*pos), home_id, 0, timer+delay+delay_temp);
-                              
-                    if (delay_temp > delay_max) {
-                        delay_max = delay_temp;
-                    }
-                    delay_pipe += network.getHeaderFlits();
+                if (FORWARD) {
+                    line_cur->state = F;
                 }
-                delay += delay_max;
             }
-            //Broadcast
-            else if (line_cur->state == B) {
-                total_num_broadcast++;
-                for(int i = 0; i < num_cores; i++) { 
-                    delay_temp = delay_pipe;
-                    delay_temp += network.transmit(home_id, i, 0, timer+delay+delay_temp);
-                    delay_temp += inval(cache[num_levels-1][i], &ins_mem_old);
-                    delay_temp += network.transmit(i, home_id, 0, timer+delay+delay_temp);
-                    if (delay_temp > delay_max) {
-                        delay_max = delay_temp;
-                    }
-                    delay_pipe += network.getHeaderFlits();
+            else if (line_cur->state == S || (FORWARD && line_cur->state == F)) {
+                supplier = -1;
+                if (FORWARD && line_cur->state == F) {
+                    supplier = findSupplier(sharer_set, ins_mem, F);
                 }
-                delay += delay_max;
-            } 
-        }
-        if(ins_mem->mem_type == WR) {
-            line_cur->state = M;
-        }
-        else {
-            line_cur->state = E;
-        }
-
-        directory_cache[home_id]->incMissCount();
-        line_cur->sharer_set.clear();
-        line_cur->sharer_set.insert(cache_id);
-        delay += dram.access(ins_mem);
-    }   
-    //Shard llc hit
-    else {
-        if (ins_mem->mem_type == WR) {
-            if ((line_cur->state == M) || (line_cur->state == E)) {
-                delay += network.transmit(home_id, *line_cur->sharer_set.begin(), 0, timer+delay);
-                delay += inval(cache[num_levels-1][(*line_cur->sharer_set.begin())], ins_mem);
-                delay += network.transmit(*line_cur->sharer_set.begin(), home_id, cache_level[num_levels-1].block_size, timer+delay);
-            }
-            else if (line_cur->state == S) {
-                delay_pipe = 0;
-                delay_max = 0;
-                for (pos = line_cur->sharer_set.begin(); pos != line_cur->sharer_set.end(); ++pos){
-                    delay_temp = delay_pipe; 
-                    delay_temp += network.transmit(home_id, (*pos), 0, timer+delay+delay_temp);
-                    delay_temp += inval(cache[num_levels-1][(*pos)], ins_mem);
-                    delay_temp += network.transmit((*pos), home_id, 0, timer+delay+delay_temp);
-                              
-                    if(delay_temp > delay_max) {
-                        delay_max = delay_temp;
-                    }
-                    delay_pipe += network.getHeaderFlits();
+                if (supplier >= 0) {
+                    delay += transmit(ins_mem, home_id, supplier, 0, timer+delay);
+                    delay += shareOwner(cache[num_levels-1][supplier], ins_mem, false, &dirty);
+                    delay += transmit(ins_mem, supplier, home_id, cache_level[num_levels-1].block_size, timer+delay);
+                    stats.inc(SYS_FORWARDED);
+                    ctx->source = LAT_FORWARDED;
+                    stats.inc(SYS_DRAM_SAVED);
                 }
-                delay += delay_max;
-            }
-            else if (line_cur->state == B) {
-                total_num_broadcast++;
-                for(int i = 0; i < num_cores; i++) { 
-                    delay_temp = delay_pipe;
-                    delay_temp += network.transmit(home_id, i, 0, timer+delay+delay_temp);
-                    delay_temp += inval(cache[num_levels-1][i], ins_mem);
-                    delay_temp += network.transmit(i, home_id, 0, timer+delay+delay_temp);
-                    if(delay_temp > delay_max) 
-                    {
-                        delay_max = delay_temp;
-                    }
-                    delay_pipe += network.getHeaderFlits();
+                else if (!SHARED_LLC) {
+                    delay += dram.access(ins_mem);
+                    ctx->source = LAT_DRAM;
                 }
-                delay += delay_max;
-            } 
-            else if(line_cur->state == V) {
-            }
-            line_cur->state = M;
-            line_cur->sharer_set.clear();
-            line_cur->sharer_set.insert(cache_id);
-        }
-        else if (ins_mem->mem_type == RD) {
-             if ((line_cur->state == M) || (line_cur->state == E)) {
-                delay += network.transmit(home_id, *line_cur->sharer_set.begin(), 0, timer+delay);
-                delay += share(cache[num_levels-1][(*line_cur->sharer_set.begin())], ins_mem);
-                delay += network.transmit(*line_cur->sharer_set.begin(), home_id, cache_level[num_levels-1].block_size, timer+delay);
-                line_cur->state = S;
-            }
-            else if (line_cur->state == S) {
-                if ((protocol_type == LIMITED_PTR) && ((int)line_cur->sharer_set.size() >= max_num_sharers)) {
+                if ((PROTOCOL == LIMITED_PTR) && (sharers.count(sharer_set) >= max_num_sharers)) {
                     line_cur->state = B;
                 }
-                else {
-                    line_cur->state = S;
+                else if (FORWARD) {
+                    line_cur->state = F;
                 }
             } 
-            else if (line_cur->state == B) {
-                line_cur->state = B;
+            else if (COHERENCE == MOESI && line_cur->state == O) {
+                supplier = findSupplier(sharer_set, ins_mem, O);
+                if (supplier >= 0) {
+                    delay += transmit(ins_mem, home_id, supplier, 0, timer+delay);
+                    delay += cache[num_levels-1][supplier]->getAccessTime();
+                    delay += transmit(ins_mem, supplier, home_id, cache_level[num_levels-1].block_size, timer+delay);
+                    stats.inc(SYS_FORWARDED);
+                    ctx->source = LAT_FORWARDED;
+                    if (!SHARED_LLC) {
+                        stats.inc(SYS_DRAM_SAVED);
+                    }
+                }
+                else if (!SHARED_LLC) {
+                    delay += dram.access(ins_mem);
+                    ctx->source = LAT_DRAM;
+                }
+            } 
+            else if (PROTOCOL == LIMITED_PTR && line_cur->state == B) {
+                if (!SHARED_LLC) {
+                    delay += dram.access(ins_mem);
+                    ctx->source = LAT_DRAM;
+                }
             } 
-            else if (line_cur->state == V) {
+            else if (SHARED_LLC && line_cur->state == V) {
                 line_cur->state = E;
             } 
-            line_cur->sharer_set.insert(cache_id);
-        }
-        //Writeback 
+            sharers.insert(sharer_set, cache_id);
+        } 
+        //Writeback
         else {
-            line_cur->state = V;
-            line_cur->sharer_set.clear();
+            //An O cache writing back leaves the other sharers in place, which
+            //are broadcast if the pointers overflowed
+            if (COHERENCE == MOESI && (line_cur->state == O || line_cur->state == B)) {
+                if (line_cur->state == O) {
+                    line_cur->state = (OWNED_PTR && sharers.count(sharer_set) >= max_num_sharers) ? B : S;
+                }
+                sharers.remove(sharer_set, cache_id);
+                if (sharers.count(sharer_set) == 0) {
+                    line_cur->state = SHARED_LLC ? V : I;
+                }
+            }
+            else {
+                line_cur->state = SHARED_LLC ? V : I;
+                sharers.clear(sharer_set);
+            }
             dram.access(ins_mem);
         }
     }
-    if (line_cur->state == B) {
+    if ((PROTOCOL == LIMITED_PTR && line_cur->state == B) || (COHERENCE == MOESI && line_cur->state == O)) {
         (*state) = S;
     }
     else {
         (*state) = line_cur->state;
     }
-    line_cur->timestamp = timer;
-    directory_cache[home_id]->unlockUp(ins_mem);
+    home->unlockUp(ins_mem);
     return delay;
 }
 
 
+// Arrival and acknowledgement times of a broadcast at every node, allocated
+// upon the first broadcast of each receive thread and reused afterwards
+static __thread uint64_t* inval_ready = NULL;
+
+// This function invalidates a line in all last-level caches, which is sent
+// from its home as one multicast, and returns the time until the home has
+// collected all acknowledgements.
+int System::broadcastInval(InsMem* ins_mem, InsMem* ins_mem_inval, int home_id, uint64_t timer)
+{
+    int i, num_nodes = network.getNumNodes();
+    uint64_t delay_max = 0;
+    uint64_t* ready = inval_ready;
+
+    if (ready == NULL) {
+        ready = inval_ready = new uint64_t [num_nodes];
+    }
+    for (i = 0; i < num_nodes; i++) {
+        ready[i] = timer;
+    }
+    if (!ins_mem->warmup) {
+        network.multicast(home_id, 0, timer, ready);
+    }
+    for (i = 0; i < num_nodes; i++) {
+        ready[i] += inval(cache[num_levels-1][i], ins_mem_inval);
+        if (ready[i] - timer > delay_max) {
+            delay_max = ready[i] - timer;
+        }
+    }
+    if (ins_mem->warmup) {
+        return delay_max;
+    }
+    return network.gather(home_id, 0, timer, ready);
+}
+
 //TLB translation from virtual addresses into physical addresses
 int System::tlb_translate(InsMem *ins_mem, int core_id, int64_t timer)
 {
     int delay = 0;
     Line* line_cur;
-    InsMem ins_mem_old;
+    InsMem ins_mem_old = *ins_mem;
     line_cur = tlb_cache[core_id].accessLine(ins_mem);
     tlb_cache[core_id].incInsCount();
     delay += tlb_cache[core_id].getAccessTime();
@@ -909,36 +1493,33 @@ int System::tlb_translate(InsMem *ins_mem, int core_id, int64_t timer)
         }
         tlb_cache[core_id].incMissCount();
         line_cur->state = V;
-        line_cur->ppage_num = page_table.translate(ins_mem);
+        tlb_cache[core_id].setPpageNum(line_cur, page_table.translate(ins_mem));
         delay += page_table.getTransDelay();
+        latency[LAT_TLB_MISS].record(delay);
     }
-    line_cur->timestamp = timer;
-    ins_mem->addr_dmem = (line_cur->ppage_num << (int)log2(page_size)) | (ins_mem->addr_dmem % page_size);
+    else {
+        tlb_cache[core_id].touchLine(line_cur);
+    }
+    ins_mem->addr_dmem = (tlb_cache[core_id].getPpageNum(line_cur) << (int)log2(page_size)) | (ins_mem->addr_dmem % page_size);
     return delay;
 }
 
-// Home allocation uses low-order bits interleaving
-int System::allocHomeId(int num_homes, uint64_t addr)
+// This function sends a message through the network and returns its delay,
+// functional warmup accesses skip the network model
+uint64_t System::transmit(InsMem* ins_mem, int sender, int receiver, int data_len, uint64_t timer)
 {
-    int offset;
-    int home_bits;
-    int home_mask;
-    //Home bits
-    offset = (int) log2(xml_sys->directory_cache.block_size );
-    home_mask = (int)ceil(log2(num_homes));
-    home_bits = (int)(((addr >> offset)) % (1 << home_mask));
-    if (home_bits < num_homes) {
-        return home_bits;
-    }   
-    else {
-        return home_bits % (1 << (home_mask-1));
+    if (ins_mem->warmup) {
+        return 0;
     }
+    return network.transmit(sender, receiver, data_len, timer);
 }
 
-int System::getHomeId(InsMem *ins_mem)
+// The requester is the last-level cache that misses, first-touch policies home
+// the page of the line on its node
+int System::getHomeId(InsMem *ins_mem, int cache_id)
 {
     int home_id;
-    home_id = allocHomeId(network.getNumNodes(), ins_mem->addr_dmem);
+    home_id = home_alloc.getHomeId(ins_mem, cache_id);
     if (home_id < 0) {
         cerr<<"Error: Wrong home id\n";
     }
@@ -952,11 +1533,303 @@ int System::getCoreCount()
     return num_cores;
 }
 
+// This function opens the CSV file the interval statistics are appended to.
+// The counters sampled so far, e.g. restored from a checkpoint, are taken as
+// the base of the first interval.
+void System::initSampling(const char* path, uint64_t interval)
+{
+    int i, j;
+    int num_nodes = network.getNumNodes();
+
+    sample_file.open(path);
+    sample_file << "cycle";
+    for (i = 0; i < num_levels; i++) {
+        sample_file << ",L" << i << "_accesses,L" << i << "_misses";
+    }
+    if (sys_type == DIRECTORY) {
+        for (i = 0; i < num_nodes; i++) {
+            sample_file << ",dir" << i << "_accesses,dir" << i << "_misses";
+        }
+    }
+    sample_file << ",net_packets,net_delay,net_distance,dram_accesses\n";
+
+    num_sample_counters = (sys_type == DIRECTORY ? 2 * num_nodes : 0) + 4;
+    sample_base = new uint64_t [num_sample_counters];
+    sample_count = new uint64_t [num_sample_counters];
+    sampleCounters(sample_base);
+    for (i = 0; i < num_levels; i++) {
+        cache_level[i].ins_count = 0;
+        cache_level[i].miss_count = 0;
+        for (j = 0; j < cache_level[i].num_caches; j++) {
+            if (cache[i][j] != NULL) {
+                cache_level[i].ins_count += cache[i][j]->getInsCount();
+                cache_level[i].miss_count += cache[i][j]->getMissCount();
+            }
+        }
+    }
+    sample_next = interval;
+    sample_interval = interval;
+}
+
+// This function fills count with the totals of the directory slices, the
+// network and the dram, the counters sampled besides the cache levels
+void System::sampleCounters(uint64_t* count)
+{
+    int i, n = 0;
+    if (sys_type == DIRECTORY) {
+        for (i = 0; i < network.getNumNodes(); i++) {
+            if (directory_cache[i] != NULL) {
+                count[n] = directory_cache[i]->getInsCount();
+                count[n+1] = directory_cache[i]->getMissCount();
+            }
+            else {
+                count[n] = 0;
+                count[n+1] = 0;
+            }
+            n += 2;
+        }
+    }
+    count[n] = network.getStat(NET_ACCESS);
+    count[n+1] = network.getStat(NET_DELAY);
+    count[n+2] = network.getStat(NET_DISTANCE);
+    count[n+3] = dram.getStat(DRAM_ACCESS);
+}
+
+// This function appends one row of interval statistics once a request passes
+// the next sampling point. Each row holds the counts since the previous row,
+// and is labeled with the last sampling point passed. Cores run ahead of each
+// other by up to the synchronization interval, so rows are approximate within
+// that bound.
+void System::sample(int64_t timer)
+{
+    int i, j;
+    uint64_t ins_count, miss_count, cycle;
+
+    pthread_mutex_lock(&sample_lock);
+    if (timer < sample_next) {
+        pthread_mutex_unlock(&sample_lock);
+        return;
+    }
+    cycle = (uint64_t)timer / sample_interval * sample_interval;
+    sample_file << cycle;
+    for (i = 0; i < num_levels; i++) {
+        ins_count = 0;
+        miss_count = 0;
+        for (j = 0; j < cache_level[i].num_caches; j++) {
+            if (cache[i][j] != NULL) {
+                ins_count += cache[i][j]->getInsCount();
+                miss_count += cache[i][j]->getMissCount();
+            }
+        }
+        cache_level[i].ins_count_timeline = ins_count - cache_level[i].ins_count;
+        cache_level[i].timeline_avg = (double)cache_level[i].ins_count_timeline / (cycle - cache_level[i].timeline);
+        sample_file << "," << cache_level[i].ins_count_timeline << "," << miss_count - cache_level[i].miss_count;
+        cache_level[i].ins_count = ins_count;
+        cache_level[i].miss_count = miss_count;
+        cache_level[i].timeline = cycle;
+    }
+    sampleCounters(sample_count);
+    for (i = 0; i < num_sample_counters; i++) {
+        sample_file << "," << sample_count[i] - sample_base[i];
+        sample_base[i] = sample_count[i];
+    }
+    sample_file << "\n";
+    sample_next = cycle + sample_interval;
+    pthread_mutex_unlock(&sample_lock);
+}
+
+void System::finishSampling()
+{
+    if (sample_file.is_open()) {
+        sample_file.close();
+    }
+}
+
+// This function dumps the per-set counters of every data cache and directory
+// slice with set_stats enabled into a CSV file, nothing is written if none is
+void System::dumpSetStats(const char* path)
+{
+    int i, j;
+    char name[16];
+    ofstream result;
+
+    for (i = 0; i < num_levels; i++) {
+        for (j = 0; j < cache_level[i].num_caches; j++) {
+            if (cache[i][j] != NULL && cache[i][j]->hasSetStats()) {
+                break;
+            }
+        }
+        if (j < cache_level[i].num_caches) {
+            break;
+        }
+    }
+    if (i == num_levels && !(directory_cache != NULL && xml_sys->directory_cache.set_stats)) {
+        return;
+    }
+    result.open(path);
+    result << "cache,cache_id,set,accesses,misses,evictions\n";
+    for (i = 0; i < num_levels; i++) {
+        snprintf(name, sizeof(name), "LEVEL%d", i);
+        for (j = 0; j < cache_level[i].num_caches; j++) {
+            if (cache[i][j] != NULL) {
+                cache[i][j]->dumpSetStats(&result, name);
+            }
+        }
+    }
+    if (directory_cache != NULL) {
+        for (i = 0; i < network.getNumNodes(); i++) {
+            if (directory_cache[i] != NULL) {
+                directory_cache[i]->dumpSetStats(&result, "dir");
+            }
+        }
+    }
+    result.close();
+}
+
+// This function saves the uncore state into a checkpoint file. Caches are
+// saved in the order of their levels, each preceded by whether it exists.
+bool System::save(const char* path)
+{
+    int i, j;
+    int num_nodes = network.getNumNodes();
+    bool exists;
+    Checkpoint ckpt;
+
+    if (!ckpt.create(path)) {
+        return false;
+    }
+    ckpt.write(&num_cores, sizeof(num_cores));
+    ckpt.write(&num_levels, sizeof(num_levels));
+    ckpt.write(&num_nodes, sizeof(num_nodes));
+    stats.save(&ckpt);
+    for (i = 0; i < NUM_LAT_CLASSES; i++) {
+        latency[i].save(&ckpt);
+    }
+    ckpt.write(home_stat, num_nodes * sizeof(int));
+    for (i = 0; i < num_levels; i++) {
+        ckpt.write(&cache_level[i].ins_count, sizeof(uint64_t));
+        ckpt.write(&cache_level[i].miss_count, sizeof(uint64_t));
+        for (j = 0; j < cache_level[i].num_caches; j++) {
+            exists = (cache[i][j] != NULL);
+            ckpt.write(&exists, sizeof(exists));
+            if (exists) {
+                cache[i][j]->save(&ckpt);
+            }
+        }
+    }
+    for (i = 0; i < num_nodes; i++) {
+        exists = (directory_cache != NULL && directory_cache[i] != NULL);
+        ckpt.write(&exists, sizeof(exists));
+        if (exists) {
+            directory_cache[i]->save(&ckpt);
+        }
+    }
+    exists = (tlb_cache != NULL);
+    ckpt.write(&exists, sizeof(exists));
+    if (exists) {
+        for (i = 0; i < num_cores; i++) {
+            tlb_cache[i].save(&ckpt);
+        }
+    }
+    exists = (snoop_filter != NULL);
+    ckpt.write(&exists, sizeof(exists));
+    if (exists) {
+        snoop_filter->save(&ckpt);
+    }
+    page_table.save(&ckpt);
+    home_alloc.save(&ckpt);
+    network.save(&ckpt);
+    dram.save(&ckpt);
+    if (!ckpt.finish()) {
+        cerr << "Error: Failed to save checkpoint " << path << "!\n";
+        return false;
+    }
+    return true;
+}
+
+// This function restores the uncore state right after init from a checkpoint
+// saved with the same configuration. Caches that existed are created again
+// before their state is restored.
+bool System::restore(const char* path)
+{
+    int i, j;
+    int num_cores_saved, num_levels_saved, num_nodes_saved;
+    int num_nodes = network.getNumNodes();
+    bool exists, ok = true;
+
+    if (!checkpoint.open(path)) {
+        return false;
+    }
+    checkpoint.read(&num_cores_saved, sizeof(num_cores_saved));
+    checkpoint.read(&num_levels_saved, sizeof(num_levels_saved));
+    checkpoint.read(&num_nodes_saved, sizeof(num_nodes_saved));
+    if (num_cores_saved != num_cores || num_levels_saved != num_levels || num_nodes_saved != num_nodes) {
+        cerr << "Error: Checkpoint " << path << " does not match the system configuration!\n";
+        return false;
+    }
+    stats.restore(&checkpoint);
+    for (i = 0; i < NUM_LAT_CLASSES; i++) {
+        latency[i].restore(&checkpoint);
+    }
+    checkpoint.read(home_stat, num_nodes * sizeof(int));
+    for (i = 0; i < num_levels && ok; i++) {
+        checkpoint.read(&cache_level[i].ins_count, sizeof(uint64_t));
+        checkpoint.read(&cache_level[i].miss_count, sizeof(uint64_t));
+        for (j = 0; j < cache_level[i].num_caches && ok; j++) {
+            checkpoint.read(&exists, sizeof(exists));
+            if (exists) {
+                ok = init_caches(i, j)->restore(&checkpoint);
+            }
+        }
+    }
+    for (i = 0; i < num_nodes && ok; i++) {
+        checkpoint.read(&exists, sizeof(exists));
+        if (exists) {
+            if (directory_cache == NULL) {
+                ok = false;
+                break;
+            }
+            init_directories(i);
+            ok = directory_cache[i]->restore(&checkpoint);
+        }
+    }
+    if (ok) {
+        checkpoint.read(&exists, sizeof(exists));
+        if (exists != (tlb_cache != NULL)) {
+            ok = false;
+        }
+        for (i = 0; i < num_cores && ok && exists; i++) {
+            ok = tlb_cache[i].restore(&checkpoint);
+        }
+    }
+    if (ok) {
+        checkpoint.read(&exists, sizeof(exists));
+        if (exists != (snoop_filter != NULL)) {
+            ok = false;
+        }
+        else if (exists) {
+            ok = snoop_filter->restore(&checkpoint);
+        }
+    }
+    if (ok) {
+        page_table.restore(&checkpoint);
+        home_alloc.restore(&checkpoint);
+        network.restore(&checkpoint);
+        dram.restore(&checkpoint);
+    }
+    if (!ok || !checkpoint.good()) {
+        cerr << "Error: Failed to restore checkpoint " << path << "!\n";
+        return false;
+    }
+    return true;
+}
 
 void System::report(ofstream* result)
 {
     int i, j;
     uint64_t ins_count = 0, miss_count = 0, evict_count = 0, wb_count = 0;
+    uint64_t pf_issued, pf_useful, pf_late, pf_polluting;
+    uint64_t mshr_merge, mshr_stall;
     double miss_rate = 0;
    
     network.report(result); 
@@ -985,6 +1858,7 @@ void System::report(ofstream* result)
         }
         *result << endl;
     }
+    home_alloc.report(result);
     *result << endl;
 
     if (tlb_enable) {
@@ -1014,8 +1888,33 @@ void System::report(ofstream* result)
     } 
 
     *result << endl;
-    *result << "Total delay caused by bus contention: " << total_bus_contention <<" cycles\n";
-    *result << "Total # of broadcast: " << total_num_broadcast <<"\n\n";
+    *result << "Total delay caused by bus contention: " << stats.get(SYS_BUS_CONTENTION) <<" cycles\n";
+    *result << "Total # of broadcast: " << stats.get(SYS_BROADCAST) <<"\n\n";
+
+    if (sys_type == DIRECTORY && coherence_type != MESI) {
+        *result << "Coherence protocol: " << (coherence_type == MOESI ? "MOESI" : "MESIF") << endl;
+        *result << "# of dirty lines kept in O instead of being written back: " << stats.get(SYS_OWNED) << endl;
+        *result << "# of accesses supplied by an O or F cache: " << stats.get(SYS_FORWARDED) << endl;
+        *result << "# of DRAM accesses saved: " << stats.get(SYS_DRAM_SAVED) << "\n\n";
+    }
+
+    *result << "Latency distribution in cycles:\n";
+    for (i = 0; i < NUM_LAT_CLASSES; i++) {
+        latency[i].report(result, lat_class_name[i], verbose_report);
+    }
+    *result << endl;
+
+    if (snoop_filter != NULL) {
+        *result << "Snoop Filter"<<"========================================================\n";
+        *result << "Simulation results for "<< xml_sys->snoop_filter_entries << " entries " << xml_sys->snoop_filter_ways
+                   << "-way snoop filter:\n";
+        *result << "The total # of snoop filter lookups: " << snoop_filter->getInsCount() << endl;
+        *result << "The # of snoop filter misses: " << snoop_filter->getMissCount() << endl;
+        *result << "The # of capacity evictions: " << snoop_filter->getEvictCount() << endl;
+        *result << "The # of back-invalidated lines: " << stats.get(SYS_SNOOP_BACK_INVAL) << endl;
+        *result << "The # of snoops sent to last-level caches: " << stats.get(SYS_SNOOPS) << endl;
+        *result << "=================================================================\n\n";
+    }
 
     for (i=0; i<num_levels; i++) {
         ins_count =0;   
@@ -1023,12 +1922,28 @@ void System::report(ofstream* result)
         evict_count = 0;
         wb_count = 0;
         miss_rate = 0;
+        pf_issued = 0;
+        pf_useful = 0;
+        pf_late = 0;
+        pf_polluting = 0;
+        mshr_merge = 0;
+        mshr_stall = 0;
         for (j=0; j<cache_level[i].num_caches; j++) {
             if (cache[i][j] != NULL) {
                 ins_count += cache[i][j]->getInsCount();
                 miss_count += cache[i][j]->getMissCount();
                 evict_count += cache[i][j]->getEvictCount();
                 wb_count += cache[i][j]->getWbCount();
+                if (cache[i][j]->prefetcher != NULL) {
+                    pf_issued += cache[i][j]->prefetcher->getIssuedCount();
+                    pf_useful += cache[i][j]->prefetcher->getUsefulCount();
+                    pf_late += cache[i][j]->prefetcher->getLateCount();
+                    pf_polluting += cache[i][j]->prefetcher->getPollutingCount();
+                }
+                if (cache[i][j]->mshr != NULL) {
+                    mshr_merge += cache[i][j]->mshr->getMergeCount();
+                    mshr_stall += cache[i][j]->mshr->getStallCycles();
+                }
             }
         }
         miss_rate = (double)miss_count / (double)ins_count; 
@@ -1041,6 +1956,16 @@ void System::report(ofstream* result)
         *result << "The # of evicted instructions: " << evict_count << endl;
         *result << "The # of writeback instructions: " << wb_count << endl;
         *result << "The cache miss rate: " << 100 * miss_rate << "%" << endl;
+        if (xml_sys->cache[i].num_mshrs > 0) {
+            *result << "The # of accesses merged into outstanding misses: " << mshr_merge << endl;
+            *result << "The # of cycles stalled for a free MSHR: " << mshr_stall << endl;
+        }
+        if (xml_sys->cache[i].prefetcher != PREFETCH_NONE) {
+            *result << "The # of issued prefetches: " << pf_issued << endl;
+            *result << "The # of useful prefetches: " << pf_useful << endl;
+            *result << "The # of late prefetches: " << pf_late << endl;
+            *result << "The # of polluting prefetches: " << pf_polluting << endl;
+        }
         *result << "=================================================================\n\n";
     }
     
@@ -1126,22 +2051,20 @@ System::~System()
         for (i=0; i<num_levels; i++) {
             delete [] cache[i];
             delete [] cache_lock[i];
-            delete [] cache_init_done[i];
         }
         for (i = 0; i < network.getNumNodes(); i++) {
             if (directory_cache[i] != NULL) {
                 delete directory_cache[i];
             }
         }
-        delete [] hit_flag;
-        delete [] delay;
         delete [] home_stat;
         delete [] cache;
         delete [] cache_level;
         delete [] directory_cache;
         delete [] tlb_cache;
+        delete snoop_filter;
         delete [] cache_lock;
         delete [] directory_cache_lock;
-        delete [] cache_init_done;
-        delete [] directory_cache_init_done;
+        delete [] sample_base;
+        delete [] sample_count;
 }
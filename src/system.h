@@ -35,11 +35,17 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <inttypes.h>
 #include <fstream>
 #include <sstream>
+#include <pthread.h>
 #include "xml_parser.h"
 #include "cache.h"
+#include "sharers.h"
 #include "network.h"
 #include "page_table.h"
 #include "dram.h"
+#include "home_alloc.h"
+#include "checkpoint.h"
+#include "stats.h"
+#include "histogram.h"
 #include "common.h"
 
 typedef enum SysType
@@ -48,13 +54,47 @@ typedef enum SysType
     BUS = 1
 } SysType;
 
-typedef enum ProtocolType
+
+typedef enum CoherenceType
+{
+    MESI = 0,
+    MOESI = 1,
+    MESIF = 2
+} CoherenceType;
+
+
+//Counters of the stats group of the system, in checkpoint order
+typedef enum SysStat
 {
-    FULL_MAP = 0,
-    LIMITED_PTR = 1
-} ProtocolType;
+    SYS_BUS_CONTENTION = 0,
+    SYS_BROADCAST = 1,
+    SYS_OWNED = 2,
+    SYS_FORWARDED = 3,
+    SYS_DRAM_SAVED = 4,
+    SYS_SNOOPS = 5,
+    SYS_SNOOP_BACK_INVAL = 6,
+    NUM_SYS_STATS = 7
+} SysStat;
 
 
+//Request classes of the latency histograms. The first five tell where a
+//request was served, the last two time parts of a request.
+typedef enum LatencyClass
+{
+    LAT_L1_HIT = 0,
+    LAT_L2_HIT = 1,         //hits in private levels between L1 and the LLC
+    LAT_LLC_HIT = 2,
+    LAT_FORWARDED = 3,      //data supplied by another last-level cache
+    LAT_DRAM = 4,
+    LAT_INVAL = 5,          //invalidation fan-out of the home to the sharers
+    LAT_TLB_MISS = 6,
+    NUM_LAT_CLASSES = 7
+} LatencyClass;
+
+static const char* const lat_class_name[NUM_LAT_CLASSES] = {
+    "L1 hit", "L2 hit", "LLC hit", "Directory-forwarded", "DRAM", "Invalidation fan-out", "TLB miss"
+};
+
 
 typedef struct CacheLevel
 {
@@ -67,14 +107,39 @@ typedef struct CacheLevel
     uint64_t    block_size;
     uint64_t    ins_count;
     uint64_t    miss_count;
-    uint64_t    ins_count_timeline;
-    uint64_t    timeline;
+    uint64_t    ins_count_timeline;     //# of accesses in the last sampling interval
+    uint64_t    timeline;               //cycle of the last sample
     double      miss_rate;
-    double      timeline_avg;
+    double      timeline_avg;           //accesses per cycle in the last sampling interval
     double      lock_time;
 } CacheLevel;
 
 
+// The state of one request while it traverses the cache hierarchy. It lives on
+// the stack of access, so requests of different cores never write to shared
+// per-core state and access can be reentered.
+typedef struct AccessCtx
+{
+    int         core_id;
+    int         delay;                  //delay accumulated by the request
+    int         overlap;                //latency of a non-blocking L1 miss beyond delay, which the core does not wait for
+    bool        hit_flag;               //set once a level hits, levels above it are not counted
+    char        source;                 //latency class of the level or home that served the request
+    char        pf_event[LEVEL_MAX];    //outcome at each level, used to train prefetchers
+    Addr        addr[LEVEL_MAX];        //request address parsed for the cache at each level
+} AccessCtx;
+
+
+class System;
+
+// Work of one thread building the caches at startup
+typedef struct BuildArg
+{
+    System*     sys;
+    int         thread_id;
+    int         num_threads;
+    pthread_barrier_t* barrier;
+} BuildArg;
 
 
 class System
@@ -82,25 +147,61 @@ class System
     public:
         void init(XmlSys* xml_sys);
         Cache* init_caches(int level, int cache_id);
-        void init_directories(int home_id);
+        Cache* init_directories(int home_id);
+        void build(int num_threads);
+        static void* buildThread(void* arg);
+        void buildPart(int thread_id, int num_threads, pthread_barrier_t* barrier);
+        void bindThread(int thread_id, int num_threads);
+        void initEngine();
+        template <bool SHARED_LLC>
+        void selectProtocol();
+        template <bool SHARED_LLC, int PROTOCOL>
+        void selectCoherence();
+        template <int SYS_TYPE, bool SHARED_LLC, int PROTOCOL, int COHERENCE>
+        void selectEngine();
         int access(int core_id, InsMem* ins_mem, int64_t timer);
-        char mesi_bus(Cache* cache_cur, int level, int cache_id, int core_id, InsMem* ins_mem, int64_t timer);
-        char mesi_directory(Cache* cache_cur, int level, int cache_id, int core_id, InsMem* ins_mem, int64_t timer);
+        template <int SYS_TYPE, bool TLB, bool SHARED_LLC, int PROTOCOL, int COHERENCE>
+        int accessEngine(int core_id, InsMem* ins_mem, int64_t timer);
+        int drain(int core_id, int64_t timer);
+        char mesi_bus(Cache* cache_cur, int level, int cache_id, AccessCtx* ctx, InsMem* ins_mem, int64_t timer);
+        template <bool SHARED_LLC, int PROTOCOL, int COHERENCE>
+        char mesi_directory(Cache* cache_cur, int level, int cache_id, AccessCtx* ctx, InsMem* ins_mem, int64_t timer);
+        bool readHit(Cache* cache_cur, int level, AccessCtx* ctx, InsMem* ins_mem, int64_t timer);
+        bool l1Hit(Cache* cache_cur, AccessCtx* ctx, InsMem* ins_mem, int64_t timer);
+        void recordAccess(Cache* cache_cur, int level, AccessCtx* ctx, InsMem* ins_mem, Line* line_cur);
+        int prefetch(AccessCtx* ctx, InsMem* ins_mem, int64_t timer);
+        void issuePrefetch(Cache* cache_cur, int level, int cache_id, int core_id, InsMem* ins_mem, uint64_t addr, int64_t timer);
+        int snoopFilter(int cache_id, InsMem* ins_mem);
+        Line* snoopEntry(InsMem* ins_mem);
+        void snoopEvict(int cache_id, InsMem* ins_mem);
         int share(Cache* cache_cur, InsMem* ins_mem);
+        int shareOwner(Cache* cache_cur, InsMem* ins_mem, bool keep_owned, bool* dirty);
+        int findSupplier(uint64_t* sharer_set, InsMem* ins_mem, char state);
         int share_children(Cache* cache_cur, InsMem* ins_mem);
         int inval(Cache* cache_cur, InsMem* ins_mem);
         int inval_children(Cache* cache_cur, InsMem* ins_mem);
-        int accessDirectoryCache(int cache_id, int home_id, InsMem* ins_mem, int64_t timer, char* state);
-        int accessSharedCache(int cache_id, int home_id, InsMem* ins_mem, int64_t timer, char* state);
-        int allocHomeId(int num_homes, uint64_t addr);
-        int getHomeId(InsMem *ins_mem);
+        template <bool SHARED_LLC, int PROTOCOL, int COHERENCE>
+        int accessHome(int cache_id, int home_id, AccessCtx* ctx, InsMem* ins_mem, int64_t timer, char* state);
+        uint64_t transmit(InsMem* ins_mem, int sender, int receiver, int data_len, uint64_t timer);
+        int broadcastInval(InsMem* ins_mem, InsMem* ins_mem_inval, int home_id, uint64_t timer);
+        int getHomeId(InsMem *ins_mem, int cache_id);
         int tlb_translate(InsMem *ins_mem, int core_id, int64_t timer);
         int getCoreCount();
         void report(ofstream* result);
+        void initSampling(const char* path, uint64_t interval);
+        void sample(int64_t timer);
+        void sampleCounters(uint64_t* count);
+        void finishSampling();
+        void dumpSetStats(const char* path);
+        bool save(const char* path);
+        bool restore(const char* path);
         ~System();        
     private:
+        int        (System::*engine)(int core_id, InsMem* ins_mem, int64_t timer);
+        char       (System::*coherence)(Cache* cache_cur, int level, int cache_id, AccessCtx* ctx, InsMem* ins_mem, int64_t timer);
         int        sys_type;
         int        protocol_type;
+        int        coherence_type;
         int        max_num_sharers;
         int        num_cores;
         int        dram_access_time;
@@ -109,23 +210,36 @@ class System
         int        tlb_enable;
         int        shared_llc;
         int        verbose_report;
-        bool       *hit_flag;
-        int*       delay;
-        int        total_num_broadcast;
-        uint64_t   total_bus_contention;
+        bool       prefetch_enable;
+        bool       l1_fast;
+        bool       eager_init;
         int*       home_stat;
+        Stats      stats;
+        Histogram  latency[NUM_LAT_CLASSES];
+        char       hit_source[LEVEL_MAX];
+        uint64_t   sample_interval;
+        volatile int64_t sample_next;   //cycle at which the next sample is written
+        int        num_sample_counters;
+        uint64_t*  sample_base;         //totals of sampleCounters at the last sample
+        uint64_t*  sample_count;        //totals of sampleCounters at the current sample, guarded by sample_lock
+        ofstream   sample_file;
+        pthread_mutex_t sample_lock;
         XmlSys*    xml_sys;
         CacheLevel* cache_level;
         Cache***   cache;
         Cache**    directory_cache;
         Cache*     tlb_cache;
+        Cache*     snoop_filter;
+        XmlCache   snoop_filter_xml;
+        Sharers    snoop_sharers;
         pthread_mutex_t** cache_lock;
         pthread_mutex_t*  directory_cache_lock;
-        bool**     cache_init_done;
-        bool*      directory_cache_init_done;
+        Sharers    sharers;
         PageTable  page_table;
         Network    network;
+        HomeAlloc  home_alloc;
         Dram       dram;
+        Checkpoint checkpoint; //kept open since restored caches use its blocks
 
 };
 
@@ -46,9 +46,17 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 void UncoreManager::init(XmlSim* xml_sim)
 {
     sys.init(&xml_sim->sys);
+    if (xml_sim->sys.eager_init) {
+        sys.build(xml_sim->num_recv_threads);
+    }
     thread_sched.init(sys.getCoreCount());
 }
 
+void UncoreManager::bindThread(int thread_id, int num_threads)
+{
+    sys.bindThread(thread_id, num_threads);
+}
+
 
 void UncoreManager::getSimStartTime()
 {
@@ -84,6 +92,36 @@ int UncoreManager::uncore_access(int core_id, InsMem* ins_mem, int64_t timer)
     return sys.access(core_id, ins_mem, timer);
 }
 
+int UncoreManager::uncore_drain(int core_id, int64_t timer)
+{
+    return sys.drain(core_id, timer);
+}
+
+void UncoreManager::initSampling(const char* path, uint64_t interval)
+{
+    sys.initSampling(path, interval);
+}
+
+void UncoreManager::finishSampling()
+{
+    sys.finishSampling();
+}
+
+void UncoreManager::dumpSetStats(const char* path)
+{
+    sys.dumpSetStats(path);
+}
+
+bool UncoreManager::saveCheckpoint(const char* path)
+{
+    return sys.save(path);
+}
+
+bool UncoreManager::restoreCheckpoint(const char* path)
+{
+    return sys.restore(path);
+}
+
 void UncoreManager::report(ofstream *result)
 {
     *result << "*********************************************************\n";
@@ -52,13 +52,20 @@ class UncoreManager
 {
     public:
         void init(XmlSim* xml_sim);
+        void bindThread(int thread_id, int num_threads);
         void getSimStartTime();
         void getSimFinishTime();
         int allocCore(int prog_id, int thread_id);
         int deallocCore(int prog_id, int thread_id);
         int getCoreId(int prog_id, int thread_id);
         int uncore_access(int core_id, InsMem* ins_mem, int64_t timer);
+        int uncore_drain(int core_id, int64_t timer);
         void report(ofstream *result);
+        void initSampling(const char* path, uint64_t interval);
+        void finishSampling();
+        void dumpSetStats(const char* path);
+        bool saveCheckpoint(const char* path);
+        bool restoreCheckpoint(const char* path);
         ~UncoreManager();        
     private:
         struct timespec sim_start_time;
@@ -47,6 +47,10 @@ XmlParser::XmlParser()
     xml_sim.thread_sync_interval = 0;
     xml_sim.proc_sync_interval = 0;
     xml_sim.syscall_cost = 0;
+    xml_sim.warmup_ins = 0;
+    xml_sim.sample_interval = 0;
+    xml_sim.checkpoint_restore = "";
+    xml_sim.checkpoint_save = "";
     xml_sim.sys.sys_type = 0;
     xml_sim.sys.protocol_type = 0;
     xml_sim.sys.max_num_sharers = 0;
@@ -61,6 +65,13 @@ XmlParser::XmlParser()
     xml_sim.sys.num_cores = 0;
     xml_sim.sys.bus_latency = 0;
     xml_sim.sys.page_miss_delay = 0;
+    xml_sim.sys.coherence = 0;
+    xml_sim.sys.snoop_filter_entries = 0;
+    xml_sim.sys.snoop_filter_ways = 16;
+    xml_sim.sys.snoop_filter_latency = 0;
+    xml_sim.sys.home_policy = 0;
+    xml_sim.sys.home_cluster_width = 2;
+    xml_sim.sys.eager_init = 0;
 
 
     xml_sim.sys.directory_cache.level = 0;
@@ -69,6 +80,15 @@ XmlParser::XmlParser()
     xml_sim.sys.directory_cache.size = 0;
     xml_sim.sys.directory_cache.block_size = 0;
     xml_sim.sys.directory_cache.num_ways = 0;
+    xml_sim.sys.directory_cache.repl_policy = 0;
+    xml_sim.sys.directory_cache.lock_type = 0;
+    xml_sim.sys.directory_cache.sparse = 0;
+    xml_sim.sys.directory_cache.index_type = 0;
+    xml_sim.sys.directory_cache.prefetcher = 0;
+    xml_sim.sys.directory_cache.prefetch_degree = 0;
+    xml_sim.sys.directory_cache.prefetch_entries = 0;
+    xml_sim.sys.directory_cache.num_mshrs = 0;
+    xml_sim.sys.directory_cache.set_stats = 0;
 
     xml_sim.sys.tlb_cache.level = 0;
     xml_sim.sys.tlb_cache.share = 0;
@@ -76,6 +96,15 @@ XmlParser::XmlParser()
     xml_sim.sys.tlb_cache.size = 0;
     xml_sim.sys.tlb_cache.block_size = 0;
     xml_sim.sys.tlb_cache.num_ways = 0;
+    xml_sim.sys.tlb_cache.repl_policy = 0;
+    xml_sim.sys.tlb_cache.lock_type = 0;
+    xml_sim.sys.tlb_cache.sparse = 0;
+    xml_sim.sys.tlb_cache.index_type = 0;
+    xml_sim.sys.tlb_cache.prefetcher = 0;
+    xml_sim.sys.tlb_cache.prefetch_degree = 0;
+    xml_sim.sys.tlb_cache.prefetch_entries = 0;
+    xml_sim.sys.tlb_cache.num_mshrs = 0;
+    xml_sim.sys.tlb_cache.set_stats = 0;
 
 
     xml_sim.sys.network.net_type = 0;
@@ -84,6 +113,8 @@ XmlParser::XmlParser()
     xml_sim.sys.network.inject_delay = 0;
     xml_sim.sys.network.router_delay = 0;
     xml_sim.sys.network.link_delay = 0;
+    xml_sim.sys.network.link_model = 0;
+    xml_sim.sys.network.link_history = 256;
 }
 
 
@@ -194,6 +225,40 @@ bool XmlParser::parseSim()
                 xmlFree(key);
                 item_count++;
  	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"warmup_ins"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.warmup_ins;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"sample_interval"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sample_interval;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"checkpoint_restore"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                xml_sim.checkpoint_restore = (key != NULL) ? (const char*)key : "";
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"checkpoint_save"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                xml_sim.checkpoint_save = (key != NULL) ? (const char*)key : "";
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
 	    cur = cur->next;
         }
 	}
@@ -249,6 +314,76 @@ bool XmlParser::parseSys()
                 //optional item is not checked
                 //item_count++;
  	        }
+	        if ((!xmlStrcmp(cur->name, (const xmlChar *)"coherence"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.coherence;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+	        if ((!xmlStrcmp(cur->name, (const xmlChar *)"snoop_filter_entries"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.snoop_filter_entries;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+	        if ((!xmlStrcmp(cur->name, (const xmlChar *)"snoop_filter_ways"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.snoop_filter_ways;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+	        if ((!xmlStrcmp(cur->name, (const xmlChar *)"snoop_filter_latency"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.snoop_filter_latency;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+	        if ((!xmlStrcmp(cur->name, (const xmlChar *)"home_policy"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.home_policy;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+	        if ((!xmlStrcmp(cur->name, (const xmlChar *)"home_cluster_width"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.home_cluster_width;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+	        if ((!xmlStrcmp(cur->name, (const xmlChar *)"eager_init"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.eager_init;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
 	        if ((!xmlStrcmp(cur->name, (const xmlChar *)"page_size"))) {
 		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
                 convert.clear();
@@ -353,6 +488,17 @@ bool XmlParser::parseSys()
         }
 	}
     xml_sim.sys.cache = new XmlCache [xml_sim.sys.num_levels]; 
+    for (int i = 0; i < xml_sim.sys.num_levels; i++) {
+        xml_sim.sys.cache[i].repl_policy = 0;
+        xml_sim.sys.cache[i].lock_type = 0;
+        xml_sim.sys.cache[i].sparse = 0;
+        xml_sim.sys.cache[i].index_type = 0;
+        xml_sim.sys.cache[i].prefetcher = 0;
+        xml_sim.sys.cache[i].prefetch_degree = 1;
+        xml_sim.sys.cache[i].prefetch_entries = 0;
+        xml_sim.sys.cache[i].num_mshrs = 0;
+        xml_sim.sys.cache[i].set_stats = 0;
+    }
     xmlXPathFreeObject(sys_node);
     return (item_count == 13);
 }
@@ -430,6 +576,26 @@ bool XmlParser::parseNetwork()
                 xmlFree(key);
                 //item_count++;
  	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"link_model"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.network.link_model;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"link_history"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.network.link_history;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
  	    cur = cur->next;
         }
 	}
@@ -512,6 +678,56 @@ bool XmlParser::parseDirectoryCache()
                 xmlFree(key);
                 item_count++;
  	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"repl_policy"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.directory_cache.repl_policy;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"lock_type"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.directory_cache.lock_type;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"sparse"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.directory_cache.sparse;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"set_stats"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.directory_cache.set_stats;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"index_type"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.directory_cache.index_type;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
  	    cur = cur->next;
         }
 	}
@@ -592,6 +808,26 @@ bool XmlParser::parseTlbCache()
                 xmlFree(key);
                 item_count++;
  	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"repl_policy"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.tlb_cache.repl_policy;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"index_type"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.tlb_cache.index_type;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
  	    cur = cur->next;
         }
 	}
@@ -673,6 +909,96 @@ bool XmlParser::parseCache()
                 xmlFree(key);
                 item_count++;
  	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"repl_policy"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.cache[i].repl_policy;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"lock_type"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.cache[i].lock_type;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"sparse"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.cache[i].sparse;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"index_type"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.cache[i].index_type;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"prefetcher"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.cache[i].prefetcher;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"prefetch_degree"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.cache[i].prefetch_degree;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"prefetch_entries"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.cache[i].prefetch_entries;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"num_mshrs"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.cache[i].num_mshrs;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
+            if ((!xmlStrcmp(cur->name, (const xmlChar *)"set_stats"))) {
+		        key = xmlNodeListGetString(doc, cur->xmlChildrenNode, 1);
+                convert.clear();
+                convert.str("");
+		        convert << key;
+                convert >> dec >> xml_sim.sys.cache[i].set_stats;
+                xmlFree(key);
+                //optional item is not checked
+                //item_count++;
+ 	        }
 	    cur = cur->next;
         }
 	}
@@ -53,6 +53,15 @@ typedef struct XmlCache
     uint64_t    size;
     uint64_t    block_size;
     uint64_t    num_ways;
+    int         repl_policy;
+    int         lock_type;
+    int         sparse;
+    int         index_type;
+    int         prefetcher;
+    int         prefetch_degree;
+    int         prefetch_entries;
+    int         num_mshrs;
+    int         set_stats;
 } XmlCache;
 
 typedef struct XmlNetwork
@@ -63,6 +72,8 @@ typedef struct XmlNetwork
     uint64_t router_delay;
     uint64_t link_delay;
     uint64_t inject_delay;
+    int link_model;         //0 -> history tree, 1 -> lock-free busy-until
+    uint64_t link_history;  //# of cycles a busy-until link looks back for late packets
 } XmlNetwork;
 
 
@@ -83,6 +94,13 @@ typedef struct XmlSys
     double     freq;
     int        bus_latency;
     int        page_miss_delay;
+    int        coherence;             //0 -> MESI, 1 -> MOESI, 2 -> MESIF
+    uint64_t   snoop_filter_entries;  //0 means no snoop filter
+    uint64_t   snoop_filter_ways;
+    int        snoop_filter_latency;
+    int        home_policy;           //0 -> line, 1 -> page, 2 -> xor, 3 -> first touch, 4 -> cluster
+    int        home_cluster_width;    //width of the square node clusters of policy 4
+    int        eager_init;            //0 -> caches built on first access, 1 -> built at startup
     XmlNetwork network;
     XmlCache   directory_cache;
     XmlCache   tlb_cache;
@@ -96,6 +114,10 @@ typedef struct XmlSim
     int        thread_sync_interval;
     int        proc_sync_interval;
     int        syscall_cost;
+    uint64_t   warmup_ins;  //# of instructions per thread simulated functionally before timing starts
+    uint64_t   sample_interval; //# of cycles between samples of the interval statistics, 0 for none
+    std::string checkpoint_restore; //checkpoint to restore the uncore from, empty for none
+    std::string checkpoint_save;    //checkpoint to save the uncore into at the end, empty for none
     XmlSys     sys; 
 } XmlSim;
 
@@ -0,0 +1,124 @@
+//===========================================================================
+// lookup_bench.cpp 
+//===========================================================================
+/*
+Copyright (c) 2015 Princeton University
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Princeton University nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY PRINCETON UNIVERSITY "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL PRINCETON UNIVERSITY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Microbenchmark of the way lookup kernels of the Cache, built with
+// "make bin/lookup_bench". For 8, 16, 24 and 32 ways, it fills a cache
+// through replaceLine, which searches for a free way, and then times
+// accessLine on addresses of which about half hit, once with each kernel
+// the host can run. Cache::init should only use a vectorized kernel at the
+// way counts where it is faster than the scalar one.
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <inttypes.h>
+#include <time.h>
+#include "cache.h"
+
+using namespace std;
+
+#define BENCH_SETS      1024
+#define BENCH_ADDRS     (1 << 16)
+#define BENCH_LOOKUPS   20000000
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Returns the ns per fill and per lookup of a cache with the given ways
+static void run(int num_ways, double* fill_ns, double* lookup_ns)
+{
+    XmlCache xml_cache;
+    Cache cache;
+    InsMem ins_mem, ins_mem_old;
+    uint64_t i, hits = 0;
+    uint64_t num_lines = (uint64_t)BENCH_SETS * num_ways;
+    uint64_t* addrs = new uint64_t [BENCH_ADDRS];
+    unsigned seed = 1;
+    double start;
+
+    memset(&xml_cache, 0, sizeof(xml_cache));
+    xml_cache.share = 1;
+    xml_cache.access_time = 1;
+    xml_cache.block_size = 64;
+    xml_cache.num_ways = num_ways;
+    xml_cache.size = num_lines * xml_cache.block_size;
+    xml_cache.prefetch_degree = 1;
+    cache.init(&xml_cache, DATA_CACHE, 0, 4096, 0, 0, 0);
+
+    memset(&ins_mem, 0, sizeof(ins_mem));
+    memset(&ins_mem_old, 0, sizeof(ins_mem_old));
+    ins_mem.prog_id = 1;
+    start = now();
+    for (i = 0; i < num_lines; i++) {
+        ins_mem.addr_dmem = i * xml_cache.block_size;
+        cache.replaceLine(&ins_mem_old, &ins_mem)->state = S;
+    }
+    *fill_ns = (now() - start) / num_lines * 1e9;
+
+    for (i = 0; i < BENCH_ADDRS; i++) {
+        addrs[i] = (rand_r(&seed) % (2 * num_lines)) * xml_cache.block_size;
+    }
+    start = now();
+    for (i = 0; i < BENCH_LOOKUPS; i++) {
+        ins_mem.addr_dmem = addrs[i % BENCH_ADDRS];
+        if (cache.accessLine(&ins_mem) != NULL) {
+            hits++;
+        }
+    }
+    *lookup_ns = (now() - start) / BENCH_LOOKUPS * 1e9;
+    if (hits == 0) {
+        cerr << "Error: No lookup hit!\n";
+    }
+    delete [] addrs;
+}
+
+int main()
+{
+    int way_counts[] = {8, 16, 24, 32};
+    int kernels[] = {LOOKUP_SCALAR, LOOKUP_AVX2};
+    const char* names[] = {"scalar", "avx2"};
+    double fill_ns, lookup_ns;
+
+    for (unsigned i = 0; i < sizeof(way_counts) / sizeof(way_counts[0]); i++) {
+        for (unsigned j = 0; j < sizeof(kernels) / sizeof(kernels[0]); j++) {
+            if (!Cache::selectLookup(kernels[j])) {
+                continue;
+            }
+            run(way_counts[i], &fill_ns, &lookup_ns);
+            cout << way_counts[i] << "-way " << names[j] << ": "
+                 << lookup_ns << " ns per lookup, " << fill_ns << " ns per fill" << endl;
+        }
+    }
+    return 0;
+}